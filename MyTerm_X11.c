@@ -1,2026 +1,6499 @@
-#define _POSIX_C_SOURCE 200809L
-#define _GNU_SOURCE
-#include <locale.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <string.h>
-#include <strings.h>
-#include <fcntl.h>
-#include <dirent.h>
-#include <ctype.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <sys/stat.h>
-#include <errno.h>
-#include <time.h>
-#include <signal.h>
-#include <glob.h>
-#include <limits.h>
-#include <wordexp.h>
-#include <sys/select.h>
-#include <sys/time.h>
-#include <X11/Xlib.h>
-#include <X11/keysym.h>
-#include <pwd.h>
-#include <stdint.h>
-#include <wchar.h>
-#include <X11/Xutil.h>
-
-#define WIDTH 900
-#define HEIGHT 600
-#define MAX_TABS 100
-#define MAX_LINES 1000
-#define MAX_LINE_LEN 4096
-
-#define LEFT_MARGIN 6
-#define TOP_MARGIN 20
-#define SCROLL_STEP 3
-#define HISTORY_MAX 10000
-#define HISTORY_SHOW 1000
-#define BUF_SIZE 1024
-#define MAX_CMDS 16
-
-typedef struct {
-    char *cmd;
-    int fd[2];
-    pid_t pid;
-    long offset;
-} MWCommand;
-
-typedef struct {
-    pid_t pid;
-    int to_child[2];
-    int from_child[2];
-    char *lines[MAX_LINES];
-    int  is_command[MAX_LINES];
-    int  lines_count;
-    char current_line[MAX_LINE_LEN];
-    int  current_len;
-    int  cursor_pos;
-    char cwd[PATH_MAX];
-    int scroll_offset;
-    char stream_line[MAX_LINE_LEN];
-    int  stream_len;
-    MWCommand mw_cmds[MAX_CMDS];
-    int mw_n;
-    int mw_maxfd;
-
-    char *autocomplete_matches[1024];
-    int  autocomplete_count;
-    int  autocomplete_start;
-    int  autocomplete_pos;
-} Tab;
-
-static char *history[HISTORY_MAX];
-static int history_count = 0;
-static int history_start = 0;
-static char history_path[PATH_MAX];
-int cursor_visible = 1;
-static XFontSet fontset = NULL;
-static int font_ascent = 13;
-static int font_descent = 5;
-static int FONT_HEIGHT;
-
-static void make_nonblocking(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1) return;
-    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-}
-
-void scroll_to_cursor(Tab *t);
-static void append_text(Tab *t, const char *s, int n);
-static void draw_ui(Display *display, Window win, GC gc, XFontStruct *font, Tab *t,
-                    int active, int tab_count, int search_mode, char *search_buf, int search_len, int search_cursor);
-
-static int is_utf8_continuation(unsigned char c) 
-{
-    return (c & 0xC0) == 0x80;
-}
-static int utf8_text_width(XFontStruct *fallback_font, const char *text, int len)
-{
-    if (!text || len <= 0) return 0;
-    if (fontset) 
-    {
-        XRectangle ink, logical;
-        Xutf8TextExtents(fontset, text, len, &ink, &logical);
-        return logical.width;
-    }
-    if (fallback_font) 
-    {
-        return XTextWidth(fallback_font, text, len);
-    }
-    return 0;
-}
-static void push_line(Tab *t, const char *line) 
-{
-    if (t->lines_count >= MAX_LINES) 
-    {
-        free(t->lines[0]);
-        memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-        memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-        t->lines_count--;
-    }
-    t->lines[t->lines_count] = strdup(line ? line : "");
-    t->is_command[t->lines_count] = 0;
-    t->lines_count++;
-}
-static void custom_echo_handler(Tab *t, const char *input)
-{
-    const char *p = input;
-    while (*p && !isspace((unsigned char)*p)) p++;
-    while (*p && isspace((unsigned char)*p)) p++;
-    if (*p != '"') 
-    {
-        push_line(t, "Error: echo requires a quoted string.");
-        return;
-    }
-    p++;
-    const char *start = p;
-    const char *end = strrchr(start, '"');
-    if (!end) 
-    {
-        push_line(t, "Error: unclosed quote in echo command.");
-        return;
-    }
-    int len = (int)(end - start);
-    char content[MAX_LINE_LEN];
-    strncpy(content, start, len);
-    content[len] = '\0';
-    char output[MAX_LINE_LEN];
-    int out_idx = 0;
-    int in_idx = 0;
-    while (in_idx < len && out_idx < MAX_LINE_LEN - 1) 
-    {
-        if (content[in_idx] == '\n' || content[in_idx] == '\r') 
-        {
-            in_idx++;
-            continue;
-        }
-        if (content[in_idx] == '\\' &&
-            in_idx + 2 < len &&
-            content[in_idx + 1] == 'n' &&
-            content[in_idx + 2] == '\\') {
-            if (out_idx > 0 && output[out_idx - 1] == ' ')
-                out_idx--;
-            output[out_idx++] = '\n';
-            in_idx += 3;
-            continue;
-        }
-        output[out_idx++] = content[in_idx++];
-    }
-    output[out_idx] = '\0';
-
-    char *line_start = output;
-    char *p2 = output;
-    while (*p2) 
-    {
-        if (*p2 == '\n') 
-        {
-            *p2 = '\0';
-            char *trim = line_start;
-            while (*trim == ' ') trim++;
-            char *endp = trim + strlen(trim);
-            while (endp > trim && endp[-1] == ' ') *--endp = '\0';
-            push_line(t, trim);
-            line_start = p2 + 1;
-        }
-        p2++;
-    }
-
-    char *trim = line_start;
-    while (*trim == ' ') trim++;
-    char *endp = trim + strlen(trim);
-    while (endp > trim && endp[-1] == ' ') *--endp = '\0';
-    push_line(t, trim);
-    scroll_to_cursor(t);
-}
-
-static int utf8_char_len(unsigned char first_byte) 
-{
-    if ((first_byte & 0x80) == 0) return 1;
-    if ((first_byte & 0xE0) == 0xC0) return 2;
-    if ((first_byte & 0xF0) == 0xE0) return 3;
-    if ((first_byte & 0xF8) == 0xF0) return 4;
-    return 1;
-}
-static void push_command_line(Tab *t, const char *line) 
-{
-    if (t->lines_count >= MAX_LINES) 
-    {
-        free(t->lines[0]);
-        memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-        memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-        t->lines_count--;
-    }
-    t->lines[t->lines_count] = strdup(line ? line : "");
-    t->is_command[t->lines_count] = 1;
-    t->lines_count++;
-}
-
-static const char *get_last_user_command(Tab *t) 
-{
-    if (!t) return NULL;
-    for (int i = t->lines_count - 1; i >= 0; --i) {
-        if (t->is_command[i] == 1 && t->lines[i] && t->lines[i][0] != '\0')
-            return t->lines[i];
-    }
-    return NULL;
-}
-
-static void debug_print_argv(char *argv[], int argc) 
-{
-    fprintf(stderr, "DEBUG: argc=%d\n", argc);
-    for (int i = 0; i < argc; ++i) {
-        if (!argv[i]) { fprintf(stderr, "DEBUG: argv[%d]=NULL\n", i); continue; }
-        fprintf(stderr, "DEBUG: argv[%d]=\"", i);
-        for (size_t j = 0; j < strlen(argv[i]); ++j) {
-            unsigned char c = (unsigned char)argv[i][j];
-            if (c >= 32 && c < 127) fputc(c, stderr);
-            else if (c == '\n') fputs("\\n", stderr);
-            else if (c == '\t') fputs("\\t", stderr);
-            else fprintf(stderr, "\\x%02X", c);
-        }
-        fputs("\"\n", stderr);
-    }
-}
-static void handle_echo(Tab *t, char *argv[], int argc) 
-{
-    if (argc <= 1) 
-    {
-        push_line(t, "");
-        scroll_to_cursor(t);
-        return;
-    }
-    size_t total = 0;
-    for (int i = 1; i < argc; i++) total += strlen(argv[i]) + 1;
-    char *full = malloc(total + 1);
-    if (!full) return;
-    full[0] = '\0';
-    for (int i = 1; i < argc; i++) 
-    {
-        if (i > 1) strcat(full, " ");
-        strcat(full, argv[i]);
-    }
-    char *line_start = full;
-    char *p = full;
-    while (*p) 
-    {
-        if (*p == '\n') 
-        {
-            *p = '\0';
-            push_line(t, line_start);
-            line_start = p + 1;
-        }
-        p++;
-    }
-    if (*line_start) push_line(t, line_start);
-    free(full);
-    scroll_to_cursor(t);
-}
-static int parse_command_line(const char *line, char *argv[], int max_args, char **allocated_buf) 
-{
-    if (!line || !argv || max_args <= 0) return 0;
-    size_t len = strlen(line);
-    char *buf = malloc(len + 1);
-    if (!buf) return 0;
-    *allocated_buf = buf;
-    int argc = 0;
-    const char *p = line;
-    while (*p && argc < max_args - 1) 
-    {
-        while (*p == ' ' || *p == '\t') p++;
-        if (!*p) break;
-        argv[argc++] = buf;
-        if (*p == '"' || *p == '\'') 
-        {
-            char quote = *p++;
-            while (*p && *p != quote) {
-                if (*p == '\\' && *(p+1)) 
-                {
-                    p++;
-                    switch (*p) 
-                    {
-                        case 'n': *buf++ = '\n'; break;
-                        case 't': *buf++ = '\t'; break;
-                        case 'r': *buf++ = '\r'; break;
-                        case '\\': *buf++ = '\\'; break;
-                        case '"': *buf++ = '"'; break;
-                        case '\'': *buf++ = '\''; break;
-                        default: *buf++ = *p; break;
-                    }
-                    p++;
-                } 
-                else 
-                {
-                    *buf++ = *p++;
-                }
-            }
-            if (*p == quote) p++;
-        } 
-        else 
-        {
-            while (*p && *p != ' ' && *p != '\t') 
-            {
-                if (*p == '\\' && *(p+1)) 
-                {
-                    p++;
-                    *buf++ = *p++;
-                } 
-                else 
-                {
-                    *buf++ = *p++;
-                }
-            }
-        }
-        *buf++ = '\0';
-    }
-    argv[argc] = NULL;
-    return argc;
-}
-
-void scroll_to_cursor(Tab *t) 
-{
-    int max_visible = (HEIGHT - TOP_MARGIN - FONT_HEIGHT) / FONT_HEIGHT;
-    if (max_visible < 1) max_visible = 1;
-    if (t->lines_count > max_visible) 
-    {
-        t->scroll_offset = t->lines_count - max_visible;
-    } 
-    else 
-    {
-        t->scroll_offset = 0;
-    }
-}
-void scroll_up(Tab *t) 
-{
-    if (t->scroll_offset > 0)
-        t->scroll_offset -= SCROLL_STEP;
-    if (t->scroll_offset < 0) t->scroll_offset = 0;
-}
-void scroll_down(Tab *t) 
-{
-    int max_visible = (HEIGHT - TOP_MARGIN - FONT_HEIGHT) / FONT_HEIGHT;
-    if (max_visible < 1) max_visible = 1;
-    int max_offset = (t->lines_count > max_visible) ? (t->lines_count - max_visible) : 0;
-    if (t->scroll_offset < max_offset)
-        t->scroll_offset += SCROLL_STEP;
-    if (t->scroll_offset > max_offset) t->scroll_offset = max_offset;
-}
-
-static void load_history_file(void) 
-{
-    struct passwd *pw = getpwuid(getuid());
-    const char *home = pw ? pw->pw_dir : getenv("HOME");
-    if (!home) return;
-    snprintf(history_path, sizeof(history_path), "%s/.myterm_history", home);
-    FILE *f = fopen(history_path, "r");
-    if (!f) return;
-    char line[4096];
-    while (fgets(line, sizeof(line), f)) 
-    {
-        size_t L = strlen(line);
-        if (L && line[L-1] == '\n') line[L-1] = '\0';
-        if (history_count < HISTORY_MAX) {
-            history[history_count++] = strdup(line);
-        } 
-        else 
-        {
-            free(history[history_start]);
-            history[history_start] = strdup(line);
-            history_start = (history_start + 1) % HISTORY_MAX;
-        }
-    }
-    fclose(f);
-}
-static void append_history_file(const char *cmd) 
-{
-    if (history_path[0] == '\0' || !cmd || cmd[0]=='\0') return;
-    FILE *f = fopen(history_path, "a");
-    if (!f) return;
-    fprintf(f, "%s\n", cmd);
-    fclose(f);
-}
-static void add_history(const char *cmd) 
-{
-    if (!cmd || cmd[0]=='\0') return;
-    if (history_count < HISTORY_MAX) 
-    {
-        history[history_count++] = strdup(cmd);
-    }
-    else 
-    {
-        free(history[history_start]);
-        history[history_start] = strdup(cmd);
-        history_start = (history_start + 1) % HISTORY_MAX;
-    }
-    append_history_file(cmd);
-}
-static void show_history_in_tab(Tab *t) 
-{
-    if (history_count == 0) 
-    {
-        if (t->lines_count >= MAX_LINES) 
-        {
-            free(t->lines[0]);
-            memmove(&t->lines[0], &t->lines[1], sizeof(char*)*(MAX_LINES-1));
-            memmove(&t->is_command[0], &t->is_command[1], sizeof(int)*(MAX_LINES-1));
-            t->lines_count--;
-        }
-        t->lines[t->lines_count] = strdup("(no history)");
-        t->is_command[t->lines_count++] = 0;
-        scroll_to_cursor(t);
-        return;
-    }
-    int shown = 0;
-    for (int i = history_count - 1; i >= 0 && shown < HISTORY_SHOW; --i, ++shown) 
-    {
-        int idx = i % HISTORY_MAX;
-        if (!history[idx]) continue;
-        if (t->lines_count >= MAX_LINES) 
-        {
-            free(t->lines[0]);
-            memmove(&t->lines[0], &t->lines[1], sizeof(char*)*(MAX_LINES-1));
-            memmove(&t->is_command[0], &t->is_command[1], sizeof(int)*(MAX_LINES-1));
-            t->lines_count--;
-        }
-        t->lines[t->lines_count] = strdup(history[idx]);
-        t->is_command[t->lines_count++] = 0;
-    }
-    scroll_to_cursor(t);
-}
-
-static int longest_common_substring_len(const char *a, const char *b) 
-{
-    int la = (int)strlen(a), lb = (int)strlen(b);
-    if (la == 0 || lb == 0) return 0;
-    int *prev = calloc(lb+1, sizeof(int));
-    int *cur = calloc(lb+1, sizeof(int));
-    int best = 0;
-    for (int i = 1; i <= la; ++i) 
-    {
-        for (int j = 1; j <= lb; ++j) 
-        {
-            if (a[i-1] == b[j-1]) 
-            {
-                cur[j] = prev[j-1] + 1;
-                if (cur[j] > best) best = cur[j];
-            } else cur[j] = 0;
-        }
-        int *tmp = prev; prev = cur; cur = tmp;
-        memset(cur, 0, (lb+1)*sizeof(int));
-    }
-    free(prev); free(cur);
-    return best;
-}
-static void perform_history_search_and_print(Tab *t, const char *term) 
-{
-    if (!term || term[0] == '\0') 
-    {
-        if (t->lines_count >= MAX_LINES) 
-        {
-            free(t->lines[0]);
-            memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-            memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-            t->lines_count--;
-        }
-        t->lines[t->lines_count] = strdup("Empty search term");
-        t->is_command[t->lines_count++] = 0;
-        scroll_to_cursor(t);
-        return;
-    }
-    for (int i = history_count - 1; i >= 0; --i) 
-    {
-        int idx = i % HISTORY_MAX;
-        if (history[idx] && strcmp(history[idx], term) == 0) 
-        {
-            if (t->lines_count >= MAX_LINES) 
-            {
-                free(t->lines[0]);
-                memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                t->lines_count--;
-            }
-            t->lines[t->lines_count] = strdup(history[idx]);
-            t->is_command[t->lines_count++] = 0;
-            scroll_to_cursor(t);
-            return;
-        }
-    }
-    int best_len = 0;
-    for (int i = 0; i < history_count; ++i) 
-    {
-        int idx = i % HISTORY_MAX;
-        if (!history[idx]) continue;
-        int lcs = longest_common_substring_len(term, history[idx]);
-        if (lcs > best_len) best_len = lcs;
-    }
-
-    if (best_len <= 2) 
-    {
-        if (t->lines_count >= MAX_LINES) 
-        {
-            free(t->lines[0]);
-            memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-            memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-            t->lines_count--;
-        }
-        t->lines[t->lines_count] = strdup("No match for search term in history");
-        t->is_command[t->lines_count++] = 0;
-        scroll_to_cursor(t);
-        return;
-    }
-    for (int i = history_count - 1; i >= 0; --i) 
-    {
-        int idx = i % HISTORY_MAX;
-        if (!history[idx]) continue;
-        int lcs = longest_common_substring_len(term, history[idx]);
-        if (lcs == best_len) {
-            if (t->lines_count >= MAX_LINES) 
-            {
-                free(t->lines[0]);
-                memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                t->lines_count--;
-            }
-            t->lines[t->lines_count] = strdup(history[idx]);
-            t->is_command[t->lines_count++] = 0;
-        }
-    }
-    scroll_to_cursor(t);
-}
-
-static char *common_prefix_array(char **arr, int n) 
-{
-    if (n <= 0) return strdup("");
-    char *prefix = strdup(arr[0]);
-    for (int i = 1; i < n; ++i) 
-    {
-        int j = 0;
-        while (prefix[j] && arr[i][j] && prefix[j] == arr[i][j]) j++;
-        prefix[j] = '\0';
-    }
-    return prefix;
-}
-
-static void autocomplete_fill_gui(Tab *t, Display *display, Window win, GC gc, XFontStruct *font) 
-{
-    int pos = t->cursor_pos;
-    if (pos > t->current_len) pos = t->current_len;
-    int start = pos - 1;
-    while (start >= 0 && !isspace((unsigned char)t->current_line[start])) start--;
-    start++;
-    int pref_len = pos - start;
-    char prefix[MAX_LINE_LEN];
-    if (pref_len < 0) pref_len = 0;
-    strncpy(prefix, &t->current_line[start], pref_len);
-    prefix[pref_len] = '\0';
-
-    for (int i = 0; i < t->autocomplete_count; i++) 
-    {
-        if (t->autocomplete_matches[i]) 
-        {
-            free(t->autocomplete_matches[i]);
-            t->autocomplete_matches[i] = NULL;
-        }
-    }
-    t->autocomplete_count = 0;
-
-    DIR *d = opendir(t->cwd[0] ? t->cwd : ".");
-    if (!d) return;
-    struct dirent *ent;
-    size_t plen = strlen(prefix);
-    while ((ent = readdir(d)) != NULL) 
-    {
-        if (plen == 0 || strncmp(ent->d_name, prefix, plen) == 0) 
-        {
-            t->autocomplete_matches[t->autocomplete_count++] = strdup(ent->d_name);
-            if (t->autocomplete_count >= 1024) break;
-        }
-    }
-    closedir(d);
-
-    if (t->autocomplete_count == 0) return;
-
-    t->autocomplete_start = start;
-    t->autocomplete_pos = pos;
-
-    if (t->autocomplete_count == 1) {
-        int matchlen = (int)strlen(t->autocomplete_matches[0]);
-        int tail_len = t->current_len - pos;
-        if (start + matchlen + tail_len < MAX_LINE_LEN) 
-        {
-            memmove(&t->current_line[start + matchlen], &t->current_line[pos], tail_len + 1);
-            memcpy(&t->current_line[start], t->autocomplete_matches[0], matchlen);
-            t->current_len = start + matchlen + tail_len;
-            t->cursor_pos = start + matchlen;
-        }
-        free(t->autocomplete_matches[0]);
-        t->autocomplete_matches[0] = NULL;
-        t->autocomplete_count = 0;
-        scroll_to_cursor(t);
-        return;
-    }
-
-    char *tmp_arr[1024];
-    for (int i = 0; i < t->autocomplete_count; ++i) tmp_arr[i] = t->autocomplete_matches[i];
-    char *pref = common_prefix_array(tmp_arr, t->autocomplete_count);
-    int pref_len2 = (int)strlen(pref);
-    if (pref_len2 > pref_len) 
-    {
-        int tail_len = t->current_len - pos;
-        if (start + pref_len2 + tail_len < MAX_LINE_LEN) 
-        {
-            memmove(&t->current_line[start + pref_len2], &t->current_line[pos], tail_len + 1);
-            memcpy(&t->current_line[start], pref, pref_len2);
-            t->current_len = start + pref_len2 + tail_len;
-            t->cursor_pos = start + pref_len2;
-        }
-        free(pref);
-        scroll_to_cursor(t);
-        return;
-    }
-    free(pref);
-
-    if (t->lines_count + t->autocomplete_count + 2 >= MAX_LINES) 
-    {
-        int drop = (t->lines_count + t->autocomplete_count + 2) - MAX_LINES;
-        for (int i = 0; i < drop; ++i) 
-        {
-            free(t->lines[0]);
-            memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (t->lines_count - 1));
-            memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (t->lines_count - 1));
-            t->lines_count--;
-        }
-    }
-
-    t->lines[t->lines_count] = strdup("Autocomplete options : ");
-    t->is_command[t->lines_count++] = 0;
-
-    for (int i = 0; i < t->autocomplete_count && t->lines_count < MAX_LINES; ++i) 
-    {
-        char tmp[MAX_LINE_LEN + 32];
-        snprintf(tmp, sizeof(tmp), "%d. %s", i + 1, t->autocomplete_matches[i]);
-        t->lines[t->lines_count] = strdup(tmp);
-        t->is_command[t->lines_count++] = 0;
-    }
-    scroll_to_cursor(t);
-    XFlush(display);
-}
-
-void autocomplete_select(Tab *t, int key_digit) 
-{
-    if (key_digit < 1 || key_digit > t->autocomplete_count) return;
-    const char *choice = t->autocomplete_matches[key_digit - 1];
-    if (!choice) return;
-
-    int start = t->autocomplete_start;
-    int pos = t->autocomplete_pos;
-    int matchlen = (int)strlen(choice);
-    int tail_len = t->current_len - pos;
-
-    if (start + matchlen + tail_len < MAX_LINE_LEN) 
-    {
-        memmove(&t->current_line[start + matchlen], &t->current_line[pos], tail_len + 1);
-        memcpy(&t->current_line[start], choice, matchlen);
-        t->current_len = start + matchlen + tail_len;
-        t->cursor_pos = start + matchlen;
-    }
-
-    for (int i = 0; i < t->autocomplete_count; ++i) 
-    {
-        free(t->autocomplete_matches[i]);
-        t->autocomplete_matches[i] = NULL;
-    }
-    t->autocomplete_count = 0;
-    scroll_to_cursor(t);
-}
-static void autocomplete_clear(Tab *t) 
-{
-    for (int i = 0; i < t->autocomplete_count; ++i) 
-    {
-        if (t->autocomplete_matches[i]) 
-        {
-            free(t->autocomplete_matches[i]);
-            t->autocomplete_matches[i] = NULL;
-        }
-    }
-    t->autocomplete_count = 0;
-    t->autocomplete_start = 0;
-    t->autocomplete_pos = 0;
-}
-
-static int parse_multiwatch_args(char *input, MWCommand cmds[], int maxcmds) 
-{
-    char *lb=strchr(input,'[');
-    char *rb=strchr(input,']');
-    if(!lb || !rb || rb<=lb) return 0;
-    char *p=lb+1;
-    int n=0;
-    while(p<rb && n<maxcmds)
-    {
-        while(p<rb && isspace((unsigned char)*p)) p++;
-        if(*p=='"'||*p=='\'')
-        {
-            char quote=*p++;
-            char tmp[1024]; int ti=0;
-            while(p<rb && *p!=quote && ti+1< (int)sizeof(tmp)) tmp[ti++]=*p++;
-            tmp[ti]='\0';
-            if(*p==quote)p++;
-            cmds[n].cmd=strdup(tmp); cmds[n].pid=-1; cmds[n].fd[0]=cmds[n].fd[1]=-1;
-            n++;
-        } 
-        else 
-        { 
-            while(p<rb && *p!=',') p++; if(*p==',') p++; 
-        }
-        while(p<rb && (*p==',' || isspace((unsigned char)*p))) p++;
-    }
-    return n;
-}
-
-static int start_multiwatch_tab(Tab *tab, MWCommand cmds_in[], int n) 
-{
-    if (n <= 0) return 0;
-    if (tab->mw_n != 0) return -1;
-
-    int maxfd = -1;
-    for (int i = 0; i < n; ++i) 
-    {
-        int pfd[2];
-        if (pipe(pfd) < 0) 
-        {
-            perror("pipe");
-            for (int j = 0; j < i; ++j) 
-            {
-                if (tab->mw_cmds[j].fd[0] >= 0) close(tab->mw_cmds[j].fd[0]);
-                if (tab->mw_cmds[j].fd[1] >= 0) close(tab->mw_cmds[j].fd[1]);
-            }
-            return -1;
-        }
-
-        pid_t pid = fork();
-        if (pid < 0) 
-        {
-            perror("fork");
-            close(pfd[0]); close(pfd[1]);
-            for (int j = 0; j < i; ++j) 
-            {
-                if (tab->mw_cmds[j].fd[0] >= 0) close(tab->mw_cmds[j].fd[0]);
-                if (tab->mw_cmds[j].fd[1] >= 0) close(tab->mw_cmds[j].fd[1]);
-            }
-            return -1;
-        }
-
-        if (pid == 0) 
-        {
-            close(pfd[0]);
-            if (dup2(pfd[1], STDOUT_FILENO) < 0) { perror("dup2 stdout"); _exit(127); }
-            if (dup2(pfd[1], STDERR_FILENO) < 0) { perror("dup2 stderr"); _exit(127); }
-            close(pfd[1]);
-
-            for (;;) 
-            {
-                char *cmdline = strdup(cmds_in[i].cmd);
-                if (!cmdline) _exit(127);
-                char *argv[64];
-                int argc = 0;
-                char *tok = strtok(cmdline, " \t\n");
-                while (tok && argc < 63) 
-                {
-                    argv[argc++] = tok;
-                    tok = strtok(NULL, " \t\n");
-                }
-                argv[argc] = NULL;
-
-                if (argc > 0) 
-                {
-                    pid_t cpid = fork();
-                    if (cpid == 0) {
-                        if (execvp(argv[0], argv) < 0) 
-                        {
-                            perror("execvp");
-                            _exit(127);
-                        }
-                    } 
-                    else if (cpid > 0) 
-                    {
-                        int status;
-                        waitpid(cpid, &status, 0);
-                    }
-                }
-                free(cmdline);
-                sleep(2);
-            }
-            _exit(0);
-        } 
-        else 
-        {
-            close(pfd[1]);
-            tab->mw_cmds[i].cmd = strdup(cmds_in[i].cmd);
-            tab->mw_cmds[i].pid = pid;
-            tab->mw_cmds[i].fd[0] = pfd[0];
-            tab->mw_cmds[i].fd[1] = -1;
-            make_nonblocking(tab->mw_cmds[i].fd[0]);
-
-            char fname[64];
-            snprintf(fname, sizeof(fname), ".temp.%d.txt", (int)pid);
-            int tf = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            if (tf >= 0) close(tf);
-            int tf2 = open(fname, O_WRONLY | O_CREAT | O_APPEND, 0644);
-            if (tf2 >= 0)
-                tab->mw_cmds[i].fd[1] = tf2;
-            else
-                tab->mw_cmds[i].fd[1] = -1;
-
-            if (tab->mw_cmds[i].fd[0] > maxfd) maxfd = tab->mw_cmds[i].fd[0];
-        }
-    }
-
-    tab->mw_n = n;
-    tab->mw_maxfd = maxfd;
-    return tab->mw_n;
-}
-
-static void stop_multiwatch_tab(Tab *tab) 
-{
-    if (tab->mw_n == 0) return;
-    for (int i = 0; i < tab->mw_n; ++i) 
-    {
-        if (tab->mw_cmds[i].pid > 0) 
-        {
-            kill(tab->mw_cmds[i].pid, SIGINT);
-        }
-    }
-    for (int i = 0; i < tab->mw_n; ++i) 
-    {
-        if (tab->mw_cmds[i].pid > 0) waitpid(tab->mw_cmds[i].pid, NULL, 0);
-        if (tab->mw_cmds[i].fd[0] >= 0) close(tab->mw_cmds[i].fd[0]);
-        if (tab->mw_cmds[i].fd[1] >= 0) close(tab->mw_cmds[i].fd[1]);
-        if (tab->mw_cmds[i].cmd) free(tab->mw_cmds[i].cmd);
-
-        char fname[64];
-        snprintf(fname, sizeof(fname), ".temp.%d.txt", (int)tab->mw_cmds[i].pid);
-        unlink(fname);
-
-        tab->mw_cmds[i].cmd = NULL;
-        tab->mw_cmds[i].fd[0] = -1;
-        tab->mw_cmds[i].fd[1] = -1;
-        tab->mw_cmds[i].pid = -1;
-    }
-    tab->mw_n = 0;
-    tab->mw_maxfd = -1;
-}
-
-static void init_tab(Tab *t, const char *inherit_cwd, int tab_number) 
-{
-    t->pid = -1;
-    t->to_child[0] = t->to_child[1] = -1;
-    t->from_child[0] = t->from_child[1] = -1;
-    for (int j = 0; j < MAX_LINES; ++j) { t->lines[j] = NULL; t->is_command[j] = 0; }
-    t->lines_count = 0;
-    t->current_len = 0;
-    t->cursor_pos = 0;
-    t->current_line[0] = '\0';
-    t->stream_len = 0;
-    t->stream_line[0] = '\0';
-    t->mw_n = 0;
-    t->mw_maxfd = -1;
-    t->scroll_offset = 0;
-    for (int i = 0; i < MAX_CMDS; ++i) 
-    { 
-        t->mw_cmds[i].cmd = NULL;
-        t->mw_cmds[i].fd[0] = t->mw_cmds[i].fd[1] = -1;
-         t->mw_cmds[i].pid = -1; 
-    }
-    for (int i = 0; i < 1024; ++i) t->autocomplete_matches[i] = NULL;
-    t->autocomplete_count = 0;
-    t->autocomplete_start = t->autocomplete_pos = 0;
-    if (inherit_cwd && inherit_cwd[0]) strncpy(t->cwd, inherit_cwd, sizeof(t->cwd)-1);
-    else if (getcwd(t->cwd, sizeof(t->cwd)) == NULL) t->cwd[0] = '\0';
-    char tab_info[64];
-    snprintf(tab_info, sizeof(tab_info), "Tab %d", tab_number);
-    t->lines[0] = strdup(tab_info);
-    t->is_command[0] = 0;
-    t->lines_count = 1;
-}
-
-static void destroy_tab(Tab *t) 
-{
-    if (t->pid > 0) 
-    {
-        kill(-t->pid, SIGKILL);
-        waitpid(t->pid, NULL, 0);
-    }
-    if (t->from_child[0] >= 0) close(t->from_child[0]);
-    if (t->to_child[1] >= 0) close(t->to_child[1]);
-    stop_multiwatch_tab(t);
-    for (int i = 0; i < t->lines_count; ++i) 
-    {
-        if (t->lines[i]) free(t->lines[i]);
-    }
-    t->lines_count = 0;
-    autocomplete_clear(t);
-}
-
-static void spawn_commands_in_tab(Tab *t, char *argv[], int argc) 
-{
-    char *input_file = NULL, *output_file = NULL;
-    char *commands[32][MAX_LINE_LEN/2+32];
-    int ncmds = 0;
-    int argi = 0, cmd_argc = 0;
-
-    int inpipe[2] = {-1, -1};
-    if (pipe(inpipe) < 0) 
-    {
-        perror("pipe");
-        return;
-    }
-
-    while (argi < argc) 
-    {
-        if (strcmp(argv[argi], "<") == 0 && argi+1 < argc) 
-        {
-            input_file = argv[++argi];
-        } 
-        else if (strcmp(argv[argi], ">") == 0 && argi+1 < argc) 
-        {
-            output_file = argv[++argi];
-        } 
-        else if (strcmp(argv[argi], "|") == 0) 
-        {
-            commands[ncmds][cmd_argc] = NULL;
-            ncmds++;
-            cmd_argc = 0;
-        } 
-        else 
-        {
-            if (strchr(argv[argi], '*') || strchr(argv[argi], '?')) 
-            {
-                glob_t g;
-                if (glob(argv[argi], 0, NULL, &g) == 0) 
-                {
-                    for (size_t gi = 0; gi < g.gl_pathc; gi++)
-                        commands[ncmds][cmd_argc++] = strdup(g.gl_pathv[gi]);
-                }
-                else 
-                {
-                    commands[ncmds][cmd_argc++] = argv[argi];
-                }
-                globfree(&g);
-            } 
-            else 
-            {
-                commands[ncmds][cmd_argc++] = argv[argi];
-            }
-        }
-        argi++;
-    }
-    commands[ncmds][cmd_argc] = NULL;
-    ncmds++;
-
-    int pipes[32][2];
-    for (int i = 0; i < ncmds-1; i++)
-        if (pipe(pipes[i]) < 0) 
-        {
-             perror("pipe"); goto skip_exec; 
-        }
-    int parent_pipe[2];
-    if (pipe(parent_pipe) < 0) 
-    { 
-        perror("pipe"); goto skip_exec; 
-    }
-    pid_t pgid = 0;
-    for (int i = 0; i < ncmds; i++) 
-    {
-        pid_t pid = fork();
-        if (pid < 0) 
-        {
-            perror("fork");
-            goto skip_exec;
-        }
-        if (pid == 0) 
-        {
-            setpgid(0, 0);
-
-            if (i == 0 && input_file) 
-            {
-                int fdin = open(input_file, O_RDONLY);
-                if (fdin < 0) { perror("open input"); _exit(127); }
-                dup2(fdin, STDIN_FILENO); close(fdin);
-            } 
-            else if (i == 0) 
-            {
-                dup2(inpipe[0], STDIN_FILENO);
-            } 
-            else if (i > 0) 
-            {
-                dup2(pipes[i-1][0], STDIN_FILENO);
-            }
-
-            if (i == ncmds-1) 
-            {
-                if (output_file) 
-                {
-                    int fdout = open(output_file, O_WRONLY|O_CREAT|O_TRUNC, 0644);
-                    if (fdout < 0) { perror("open output"); _exit(127); }
-                    dup2(fdout, STDOUT_FILENO);
-                    dup2(fdout, STDERR_FILENO);
-                    close(fdout);
-                } 
-                else 
-                {
-                    dup2(parent_pipe[1], STDOUT_FILENO);
-                    dup2(parent_pipe[1], STDERR_FILENO);
-                }
-            } 
-            else 
-            {
-                dup2(pipes[i][1], STDOUT_FILENO);
-            }
-
-            for (int j = 0; j < ncmds-1; j++) 
-            {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-            close(parent_pipe[0]);
-            close(parent_pipe[1]);
-            close(inpipe[1]);
-            if (t->cwd[0]) chdir(t->cwd);
-            execvp(commands[i][0], commands[i]);
-            perror("execvp");
-            _exit(127);
-        } 
-        else 
-        {
-            if (pgid == 0) pgid = pid;
-            setpgid(pid, pgid);
-            t->pid = pgid;
-        }
-    }
-
-    for (int i = 0; i < ncmds-1; i++) 
-    {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
-    }
-
-    close(parent_pipe[1]);
-    t->from_child[0] = parent_pipe[0];
-    make_nonblocking(t->from_child[0]);
-
-    close(inpipe[0]);
-    t->to_child[1] = inpipe[1];
-    t->to_child[0] = -1;
-    make_nonblocking(t->to_child[1]);
-
-skip_exec:
-    (void)0;
-}
-
-
-static void append_text(Tab *t, const char *s, int n) 
-{
-    for (int i = 0; i < n; ++i) 
-    {
-        unsigned char c = (unsigned char)s[i];
-        if (c == '\r') continue;
-
-        if (c == '\n') {
-            t->stream_line[t->stream_len] = '\0';
-
-            if (t->lines_count >= MAX_LINES) 
-            {
-                free(t->lines[0]);
-                memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                t->lines_count--;
-            }
-            t->lines[t->lines_count] = strdup(t->stream_line);
-            t->is_command[t->lines_count] = 0;
-            t->lines_count++;
-            t->stream_len = 0;
-            t->stream_line[0] = '\0';
-
-            scroll_to_cursor(t);
-        } 
-        else 
-        {
-            if (t->stream_len < MAX_LINE_LEN - 1) 
-            {
-                t->stream_line[t->stream_len++] = (char)c;
-            } 
-            else 
-            {
-                t->stream_line[t->stream_len] = '\0';
-                if (t->lines_count >= MAX_LINES) 
-                {
-                    free(t->lines[0]);
-                    memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                    memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                    t->lines_count--;
-                }
-                t->lines[t->lines_count] = strdup(t->stream_line);
-                t->is_command[t->lines_count++] = 0;
-                t->stream_len = 0;
-                t->stream_line[0] = '\0';
-            }
-        }
-    }
-}
-
-static int set_tab_cwd(Tab *t, const char *path) 
-{
-    if (!path) return -1;
-    char candidate[PATH_MAX];
-    if (path[0] == '/') 
-    {
-        strncpy(candidate, path, sizeof(candidate)-1);
-        candidate[sizeof(candidate)-1] = '\0';
-    } 
-    else 
-    {
-        if (t->cwd[0] == '\0') 
-        {
-            if (!getcwd(candidate, sizeof(candidate))) return -1;
-            strncat(candidate, "/", sizeof(candidate) - strlen(candidate) - 1);
-            strncat(candidate, path, sizeof(candidate) - strlen(candidate) - 1);
-        } 
-        else 
-        {
-            snprintf(candidate, sizeof(candidate), "%s/%s", t->cwd, path);
-        }
-    }
-    struct stat st;
-    if (stat(candidate, &st) == 0 && S_ISDIR(st.st_mode)) 
-    {
-        char realp[PATH_MAX];
-        if (realpath(candidate, realp)) 
-        {
-            strncpy(t->cwd, realp, sizeof(t->cwd)-1);
-            t->cwd[sizeof(t->cwd)-1] = '\0';
-        } 
-        else 
-        {
-            strncpy(t->cwd, candidate, sizeof(t->cwd)-1);
-            t->cwd[sizeof(t->cwd)-1] = '\0';
-        }
-        return 0;
-    } 
-    else 
-    {
-        return -1;
-    }
-}
-
-void draw_ui(Display *display, Window win, GC gc, XFontStruct *font, Tab *t,
-                    int active, int tab_count, int search_mode, char *search_buf, int search_len, int search_cursor)
-{
-    XClearWindow(display, win);
-    int max_visible_history = (HEIGHT - TOP_MARGIN - FONT_HEIGHT) / FONT_HEIGHT;
-    if (max_visible_history < 1) max_visible_history = 1;
-
-    if (t->scroll_offset < 0) t->scroll_offset = 0;
-    if (t->scroll_offset > t->lines_count) t->scroll_offset = t->lines_count;
-
-    int start = t->scroll_offset;
-    int end = start + max_visible_history;
-    if (end > t->lines_count) end = t->lines_count;
-
-    int y = TOP_MARGIN;
-    for (int li = start; li < end; ++li) {
-         if (t->lines[li]) {
-            char linebuf[MAX_LINE_LEN + 64];
-            if (t->is_command[li]) {
-                snprintf(linebuf, sizeof(linebuf), "user@myterm> %s", t->lines[li]);
-            } else {
-                snprintf(linebuf, sizeof(linebuf), "%s", t->lines[li]);
-            }
-            if (fontset) {
-                Xutf8DrawString(display, win, fontset, gc, LEFT_MARGIN, y,
-                                linebuf, (int)strlen(linebuf));
-            } else {
-                XDrawString(display, win, gc, LEFT_MARGIN, y,
-                            linebuf, (int)strlen(linebuf));
-            }
-        }
-        y += FONT_HEIGHT;
-    }
-
-    int input_baseline;
-    if (t->lines_count == 0)
-        input_baseline = TOP_MARGIN + FONT_HEIGHT * 1;
-    else
-        input_baseline = y;
-
-    if (input_baseline > HEIGHT - FONT_HEIGHT)
-        input_baseline = HEIGHT - FONT_HEIGHT;
-
-    const char *prompt = "user@myterm> ";
-    int prompt_width = utf8_text_width(font, prompt, (int)strlen(prompt));
-    if (fontset) {
-        Xutf8DrawString(display, win, fontset, gc, LEFT_MARGIN, input_baseline,
-                        prompt, (int)strlen(prompt));
-    } else {
-        XDrawString(display, win, gc, LEFT_MARGIN, input_baseline,
-                    prompt, (int)strlen(prompt));
-    }
-
-    if (search_mode) {
-        const char *sp = "Enter search term: ";
-        int spw = utf8_text_width(font, sp, (int)strlen(sp));
-        if (fontset) {
-            Xutf8DrawString(display, win, fontset, gc,
-                            LEFT_MARGIN + prompt_width, input_baseline,
-                            sp, (int)strlen(sp));
-        } else {
-            XDrawString(display, win, gc,
-                        LEFT_MARGIN + prompt_width, input_baseline,
-                        sp, (int)strlen(sp));
-        }
-        if (search_len > 0) {
-            if (fontset) {
-                Xutf8DrawString(display, win, fontset, gc,
-                                LEFT_MARGIN + prompt_width + spw, input_baseline,
-                                search_buf, search_len);
-            } else {
-                XDrawString(display, win, gc,
-                            LEFT_MARGIN + prompt_width + spw, input_baseline,
-                            search_buf, search_len);
-            }
-        }
-    } else if (t->current_len > 0) {
-        if (fontset) {
-            Xutf8DrawString(display, win, fontset, gc,
-                            LEFT_MARGIN + prompt_width, input_baseline,
-                            t->current_line, t->current_len);
-        } else {
-            XDrawString(display, win, gc,
-                        LEFT_MARGIN + prompt_width, input_baseline,
-                        t->current_line, t->current_len);
-        }
-    }
-
-    char tb[64];
-    snprintf(tb, sizeof(tb), "[Tab %d/%d]", active + 1, tab_count);
-    int tw = utf8_text_width(font, tb, (int)strlen(tb));
-    if (fontset) {
-        Xutf8DrawString(display, win, fontset, gc,
-                        WIDTH - LEFT_MARGIN - tw, TOP_MARGIN - 6,
-                        tb, (int)strlen(tb));
-    } else {
-        XDrawString(display, win, gc,
-                    WIDTH - LEFT_MARGIN - tw, TOP_MARGIN - 6,
-                    tb, (int)strlen(tb));
-    }
-
-    if (cursor_visible) {
-        XSetForeground(display, gc, WhitePixel(display, DefaultScreen(display)));
-        int cursor_x;
-        if (search_mode) {
-            const char *sp = "Enter search term: ";
-            int spw = utf8_text_width(font, sp, (int)strlen(sp));
-            cursor_x = LEFT_MARGIN + prompt_width + spw +
-                       utf8_text_width(font, search_buf, search_cursor);
-        } else {
-            cursor_x = LEFT_MARGIN + prompt_width +
-                       utf8_text_width(font, t->current_line, t->cursor_pos);
-        }
-        int cursor_h = font_ascent + font_descent;
-        int cursor_w = 4;
-        int cursor_y = input_baseline - font_ascent;
-        XFillRectangle(display, win, gc, cursor_x, cursor_y, cursor_w, cursor_h);
-    }
-
-    XFlush(display);
-}
-
-int main() {
-    setlocale(LC_ALL, "");
-    const char *loc = setlocale(LC_CTYPE, NULL);
-    if (!loc || !strstr(loc, "UTF-8")) {
-        setenv("LANG", "en_US.UTF-8", 1);
-        setenv("LC_CTYPE", "en_US.UTF-8", 1);
-        setlocale(LC_ALL, "");
-    }
-    setenv("TZ", "Asia/Kolkata", 1);
-    tzset();
-
-    signal(SIGCHLD, SIG_IGN);
-
-    history_path[0] = '\0';
-    load_history_file();
-
-    Display *display = XOpenDisplay(NULL);
-    if (!display) {
-        fprintf(stderr, "Cannot open X display.\n");
-        return 1;
-    }
-    XFontStruct *font = NULL;
-
-    char **missing_list = NULL;
-    int missing_count = 0;
-    char *default_string = NULL;
-
-    fontset = XCreateFontSet(display,
-                             "-*-monospace-*-*-*-*-16-*-*-*-*-*-iso10646-1",
-                             &missing_list, &missing_count, &default_string);
-    if (fontset) {
-        XFontStruct **fs_list = NULL;
-        char **fn_list = NULL;
-        if (XFontsOfFontSet(fontset, &fs_list, &fn_list) > 0 && fs_list[0]) {
-            font_ascent = fs_list[0]->ascent;
-            font_descent = fs_list[0]->descent;
-        }
-    }
-
-    font = XLoadQueryFont(display, "fixed");
-    if (!font) {
-        fprintf(stderr, "Failed to load fallback font.\n");
-        XCloseDisplay(display);
-        return 1;
-    }
-    if (!fontset) {
-        font_ascent = font->ascent;
-        font_descent = font->descent;
-    }
-
-    FONT_HEIGHT = font_ascent + font_descent;
-    int screen = DefaultScreen(display);
-    Window root = RootWindow(display, screen);
-    Window win = XCreateSimpleWindow(display, root, 10, 10, WIDTH, HEIGHT, 1,
-                                     WhitePixel(display, screen), BlackPixel(display, screen));
-    XMapWindow(display, win);
-    GC gc = XCreateGC(display, win, 0, NULL);
-    XSetForeground(display, gc, WhitePixel(display, screen));
-    XSetBackground(display, gc, BlackPixel(display, screen));
-    XSelectInput(display, win, KeyPressMask | ExposureMask | ButtonPressMask);
-    XSetFont(display, gc, font->fid);
-    if (!font) {
-        fprintf(stderr, "Cannot load font 'fixed'\n");
-        XCloseDisplay(display);
-        return 1;
-    }
-    XSetFont(display, gc, font->fid);
-
-    XIM xim = XOpenIM(display, NULL, NULL, NULL);
-    XIC xic = NULL;
-    if (xim) {
-        xic = XCreateIC(xim,
-                        XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
-                        XNClientWindow, win,
-                        NULL);
-    }
-
-    Tab tabs[MAX_TABS];
-    int tab_count = 1;
-    if (tab_count > MAX_TABS) tab_count = MAX_TABS;
-    int active = 0;
-    char basecwd[PATH_MAX];
-    if (getcwd(basecwd, sizeof(basecwd)) == NULL) basecwd[0] = '\0';
-    for (int i = 0; i < MAX_TABS; ++i) {
-        tabs[i].scroll_offset = 0;
-        init_tab(&tabs[i], basecwd, i+1);
-    }
-
-    #define PID_OFF_MAP_SIZE 8192
-    static off_t pid_offsets[PID_OFF_MAP_SIZE];
-    memset(pid_offsets, 0, sizeof(pid_offsets));
-
-    struct timespec ts = {0, 50000000};
-    static long blink_counter = 0;
-    int search_mode = 0;
-    char search_buf[MAX_LINE_LEN];
-    int search_len = 0;
-    int search_cursor = 0;
-    XEvent ev;
-
-    while (1) 
-    {
-        while (XPending(display)) 
-        {
-            XNextEvent(display, &ev);
-            if (ev.type == KeyPress) 
-            {
-                char buf[256];
-                KeySym k = NoSymbol;
-                int len = 0;
-                Status xst = 0;
-                if (xic) {
-                    len = Xutf8LookupString(xic, &ev.xkey, buf, (int)sizeof(buf)-1, &k, &xst);
-                } else {
-                    len = XLookupString(&ev.xkey, buf, sizeof(buf)-1, &k, NULL);
-                }
-                buf[len] = '\0';
-
-                Tab *t = &tabs[active];
-                int ctrl = ev.xkey.state & ControlMask;
-                int shift = ev.xkey.state & ShiftMask;
-
-                if (search_mode) {
-                    if (len == 1) {
-                        unsigned char ch = (unsigned char)buf[0];
-                        if (ch == 0x1B) {
-                            search_mode = 0;
-                            search_len = search_cursor = 0;
-                            search_buf[0] = '\0';
-                        } else if (ch == 0x7F || k == XK_BackSpace) {
-                            if (search_cursor > 0) {
-                                memmove(&search_buf[search_cursor-1], &search_buf[search_cursor],
-                                        search_len - search_cursor + 1);
-                                search_cursor--;
-                                search_len--;
-                            }
-                        } else if (ch == '\r' || ch == '\n' || k == XK_Return) {
-                            search_buf[search_len] = '\0';
-                            perform_history_search_and_print(t, search_buf);
-                            search_mode = 0;
-                            search_len = search_cursor = 0;
-                            search_buf[0] = '\0';
-                        } else if (ch >= 32 && ch < 127) {
-                            if (search_len < MAX_LINE_LEN-1) {
-                                memmove(&search_buf[search_cursor+1], &search_buf[search_cursor],
-                                        search_len - search_cursor + 1);
-                                search_buf[search_cursor] = ch;
-                                search_len++;
-                                search_cursor++;
-                            }
-                        }
-                    }
-                    continue;
-                }
-
-                if (ctrl && shift && (k == XK_T || k == XK_t)) 
-                {
-                    if (tab_count < MAX_TABS) 
-                    {
-                        init_tab(&tabs[tab_count], basecwd, tab_count+1);
-                        tab_count++;
-                        active = tab_count - 1;
-                    }
-                    continue;
-                }
-                if (ctrl && shift && (k == XK_W || k == XK_w)) 
-                {
-                    if (tab_count > 1) 
-                    {
-                        destroy_tab(&tabs[active]);
-                        for (int i = active; i < tab_count-1; ++i) tabs[i] = tabs[i+1];
-                        tab_count--;
-                        if (active >= tab_count) active = tab_count-1;
-                    } 
-                    else 
-                    {
-                        destroy_tab(&tabs[active]);
-                        tab_count = 0;
-                        XCloseDisplay(display);
-                        exit(0);
-                    }
-                    continue;
-                }
-                if (ctrl && !shift && k == XK_Tab) 
-                {
-                    active = (active + 1) % tab_count;
-                    continue;
-                }
-                if (ctrl && shift && k == XK_Tab) 
-                {
-                    active = (active - 1 + tab_count) % tab_count;
-                    continue;
-                }
-                if (k == XK_Up) 
-                { 
-                    scroll_up(&tabs[active]); 
-                    continue; 
-                }
-                if (k == XK_Down) 
-                { 
-                    scroll_down(&tabs[active]); 
-                    continue; 
-                }
-                if (!search_mode && !ctrl && !shift && k == XK_Tab) {
-                    autocomplete_fill_gui(t, display, win, gc, font);
-                    draw_ui(display, win, gc, font, t, active, tab_count, search_mode, search_buf, search_len, search_cursor);
-                    continue;
-                }
-
-                if (t->pid > 0 && t->to_child[1] >= 0 && len > 0) {
-                    unsigned char ch = (unsigned char)buf[0];
-                    if (!(len == 1 && (ch == 0x03 || ch == 0x1A))) {
-                        ssize_t w = write(t->to_child[1], buf, len);
-                        (void)w;
-                        continue;
-                    }
-                }
-                if (t->autocomplete_count > 0 && len == 1) 
-                {
-                    unsigned char ch = (unsigned char)buf[0];
-                    int knum = -1;
-                    if (ch >= '1' && ch <= '9') knum = ch - '1';
-                    else if (ch == '0' && t->autocomplete_count >= 10) knum = 9;
-                    if (knum >= 0 && knum < t->autocomplete_count) 
-                    {
-                        int matchlen = (int)strlen(t->autocomplete_matches[knum]);
-                        int tail_len = t->current_len - t->autocomplete_pos;
-                        if (t->autocomplete_start + matchlen + tail_len < MAX_LINE_LEN) 
-                        {
-                            memmove(&t->current_line[t->autocomplete_start + matchlen],
-                                    &t->current_line[t->autocomplete_pos], tail_len + 1);
-                            memcpy(&t->current_line[t->autocomplete_start],
-                                   t->autocomplete_matches[knum], matchlen);
-                            t->current_len = t->autocomplete_start + matchlen + tail_len;
-                            t->cursor_pos = t->autocomplete_start + matchlen;
-                        } 
-                        else 
-                        {
-                            t->current_len = t->autocomplete_start + matchlen;
-                            t->cursor_pos = t->current_len;
-                        }
-                        for (int i = 0; i < t->autocomplete_count; i++) 
-                        {
-                            if (t->autocomplete_matches[i]) 
-                            { 
-                                free(t->autocomplete_matches[i]); 
-                                t->autocomplete_matches[i] = NULL; 
-                            }
-                        }
-                        t->autocomplete_count = 0;
-                        scroll_to_cursor(t);
-                        draw_ui(display, win, gc, font, t, active, tab_count, search_mode, search_buf, search_len, search_cursor);
-                        continue;
-                    }
-                    scroll_to_cursor(t);
-                }
-
-                if (len == 1) 
-                {
-                    unsigned char ch = (unsigned char)buf[0];
-                    if (ch == 0x01) 
-                    {
-                        t->cursor_pos = 0;
-                        continue;
-                    } 
-                    else if (ch == 0x05) 
-                    {
-                        t->cursor_pos = t->current_len;
-                        continue;
-                    } 
-                    else if (ch == 0x12) 
-                    {
-                        search_mode = 1;
-                        search_len = search_cursor = 0;
-                        search_buf[0] = '\0';
-                        continue;
-                    } 
-                    else if (ch == 0x03) 
-                    {
-                        if (t->pid > 0) 
-                        {
-                            pid_t pgid = t->pid;
-                            kill(-pgid, SIGINT);
-                            if (t->lines_count >= MAX_LINES) 
-                            {
-                                free(t->lines[0]);
-                                memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                                memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                                t->lines_count--;
-                            }
-                            t->lines[t->lines_count] = strdup("^C");
-                            t->is_command[t->lines_count] = 0;
-                            t->lines_count++;
-                            scroll_to_cursor(t);
-                        } 
-                        else if (t->mw_n > 0) 
-                        {
-                            for (int i = 0; i < t->mw_n; ++i) 
-                            {
-                                if (t->mw_cmds[i].pid > 0) 
-                                {
-                                    kill(t->mw_cmds[i].pid, SIGTERM);
-                                    char fname[64];
-                                    snprintf(fname, sizeof(fname), ".temp.%d.txt", (int)t->mw_cmds[i].pid);
-                                    unlink(fname);
-                                }
-                            }
-                            stop_multiwatch_tab(t);
-                            if (t->lines_count >= MAX_LINES) 
-                            {
-                                free(t->lines[0]);
-                                memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                                memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                                t->lines_count--;
-                            }
-                            t->lines[t->lines_count] = strdup("^C - MultiWatch stopped");
-                            t->is_command[t->lines_count] = 0;
-                            t->lines_count++;
-                            scroll_to_cursor(t);
-                        }
-                        continue;
-                    } 
-                    else if (ch == 0x1A) 
-                    {
-                        if (t->pid > 0) 
-                        {
-                            pid_t pgid = t->pid;
-                            kill(-pgid, SIGTSTP);
-                            if (t->lines_count >= MAX_LINES) 
-                            {
-                                free(t->lines[0]);
-                                memmove(&t->lines[0], &t->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                                memmove(&t->is_command[0], &t->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                                t->lines_count--;
-                            }
-                            t->lines[t->lines_count] = strdup("[stopped]");
-                            t->is_command[t->lines_count] = 0;
-                            t->lines_count++;
-                            if (t->from_child[0] >= 0) 
-                            {
-                                close(t->from_child[0]);
-                                t->from_child[0] = -1;
-                            }
-                            t->pid = -1;
-                            scroll_to_cursor(t);
-                        }
-                        continue;
-                    }
-                }
-
-                if (k == XK_BackSpace || (len == 1 && buf[0] == 0x7F)) 
-                {
-                    if (t->cursor_pos > 0) 
-                    {
-                        int del_bytes = 1;
-                        int pos = t->cursor_pos - 1;
-                        while (pos > 0 && is_utf8_continuation((unsigned char)t->current_line[pos])) 
-                        {
-                            pos--;
-                            del_bytes++;
-                        }
-                        memmove(&t->current_line[pos],
-                                &t->current_line[t->cursor_pos],
-                                t->current_len - t->cursor_pos + 1);
-                        t->cursor_pos = pos;
-                        t->current_len -= del_bytes;
-                    }
-                    continue;
-                }
-
-                if (k == XK_Return || (len == 1 && (buf[0] == '\r' || buf[0] == '\n'))) 
-                {
-                    if (t->current_len > 0 && t->current_line[t->current_len - 1] == '\\') 
-                    {
-                        if (t->current_len < MAX_LINE_LEN - 1) 
-                        {
-                            t->current_line[t->current_len++] = '\n';
-                            t->current_line[t->current_len] = '\0';
-                            t->cursor_pos = t->current_len;
-                        }
-                        continue;
-                    }
-
-                    t->current_line[t->current_len] = '\0';
-
-                    char *cmdbuf_check = NULL;
-                    char *argv_check[MAX_LINE_LEN/2+1];
-                    int argc_check = parse_command_line(t->current_line, argv_check, (int)(sizeof(argv_check)/sizeof(argv_check[0])), &cmdbuf_check);
-                    int is_echo = (argc_check > 0 && strcasecmp(argv_check[0], "echo") == 0);
-
-                    char display_line[MAX_LINE_LEN];
-                    strncpy(display_line, t->current_line, MAX_LINE_LEN - 1);
-                    display_line[MAX_LINE_LEN - 1] = '\0';
-
-                    push_command_line(t, display_line);
-                    scroll_to_cursor(t);
-
-                    add_history(t->current_line);
-
-                    char *cmdbuf = NULL;
-                    char *argv[MAX_LINE_LEN/2+1];
-                    int argc = parse_command_line(t->current_line, argv, (int)(sizeof(argv)/sizeof(argv[0])), &cmdbuf);
-
-                    if (argc > 0) 
-                    {
-                        if (strcasecmp(argv[0], "echo") == 0) 
-                        {
-                            custom_echo_handler(t, t->current_line);
-                        } 
-                        else if (strcasecmp(argv[0], "multiwatch") == 0) 
-                        {
-                            MWCommand mwtmp[MAX_CMDS];
-                            int mn = parse_multiwatch_args(t->current_line, mwtmp, MAX_CMDS);
-                            if (mn > 0) {
-                                if (t->mw_n == 0) {
-                                    if (start_multiwatch_tab(t, mwtmp, mn) <= 0) {
-                                        push_line(t, "Failed to start multiWatch");
-                                    }
-                                    scroll_to_cursor(t);
-                                }
-                            } else {
-                                push_line(t, "Usage: multiWatch [\"cmd1\",\"cmd2\",...]");
-                                scroll_to_cursor(t);
-                            }
-                            for (int i = 0; i < mn; ++i) if (mwtmp[i].cmd) free(mwtmp[i].cmd);
-                        } 
-                        else if (strcmp(argv[0], "cd") == 0) 
-                        {
-                            if (argc > 1) 
-                            {
-                                if (set_tab_cwd(t, argv[1]) == 0) 
-                                {
-                                    char tab_info[64];
-                                    snprintf(tab_info, sizeof(tab_info), "Tab %d", active+1);
-                                    free(t->lines[0]);
-                                    t->lines[0] = strdup(tab_info);
-                                    push_line(t, "Directory changed");
-                                    scroll_to_cursor(t);
-                                } else 
-                                {
-                                    char errbuf[256];
-                                    snprintf(errbuf, sizeof(errbuf), "cd: %s: %s", argv[1], strerror(errno));
-                                    push_line(t, errbuf);
-                                    scroll_to_cursor(t);
-                                }
-                            } 
-                            else if (getenv("HOME")) 
-                            {
-                                if (set_tab_cwd(t, getenv("HOME")) == 0) 
-                                {
-                                    char tab_info[64];
-                                    snprintf(tab_info, sizeof(tab_info), "Tab %d", active+1);
-                                    free(t->lines[0]);
-                                    t->lines[0] = strdup(tab_info);
-                                    scroll_to_cursor(t);
-                                }
-                            }
-                        } 
-                        else if (strcmp(argv[0], "clear") == 0) 
-                        {
-                            char tab_label[64];
-                            snprintf(tab_label, sizeof(tab_label), "Tab %d", active + 1);
-                            if (t->lines[0] == NULL || strcmp(t->lines[0], tab_label) != 0) {
-                                free(t->lines[0]);
-                                t->lines[0] = strdup(tab_label);
-                            }
-                            t->is_command[0] = 0;
-                            for (int i = 1; i < t->lines_count; i++) {
-                                free(t->lines[i]);
-                                t->lines[i] = NULL;
-                                t->is_command[i] = 0;
-                            }
-                            t->lines_count = 1;
-                            t->scroll_offset = 0;
-                        } 
-                        else if (strcmp(argv[0], "exit") == 0) 
-                        {
-                            if (cmdbuf) free(cmdbuf);
-                            if (cmdbuf_check) free(cmdbuf_check);
-                            if (xic) XDestroyIC(xic);
-                            if (xim) XCloseIM(xim);
-                            XFreeFont(display, font);
-                            XCloseDisplay(display);
-                            return 0;
-                        } else if (strcmp(argv[0], "history") == 0) {
-                            show_history_in_tab(t);
-                        } else {
-                            spawn_commands_in_tab(t, argv, argc);
-                        }
-                    }
-
-                    t->current_len = 0;
-                    t->cursor_pos = 0;
-                    t->current_line[0] = '\0';
-
-                    if (cmdbuf) free(cmdbuf);
-                    if (cmdbuf_check) free(cmdbuf_check);
-                    continue;
-                }
-
-                if (len > 0) {
-                    Tab *t2 = &tabs[active];
-                    int bytes_to_insert = len;
-                    if (t2->current_len + bytes_to_insert < MAX_LINE_LEN - 1) {
-                        memmove(&t2->current_line[t2->cursor_pos + bytes_to_insert],
-                                &t2->current_line[t2->cursor_pos],
-                                t2->current_len - t2->cursor_pos + 1);
-                        memcpy(&t2->current_line[t2->cursor_pos], buf, bytes_to_insert);
-                        t2->cursor_pos += bytes_to_insert;
-                        t2->current_len += bytes_to_insert;
-                        t2->current_line[t2->current_len] = '\0';
-                    }
-                }
-                continue;
-            } else if (ev.type == ButtonPress) {
-                if (ev.xbutton.button == Button4) {
-                    scroll_up(&tabs[active]);
-                } else if (ev.xbutton.button == Button5) {
-                    scroll_down(&tabs[active]);
-                }
-            }
-        }
-
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        int maxfd = -1;
-        for (int i = 0; i < tab_count; ++i) {
-            Tab *tt = &tabs[i];
-            if (tt->from_child[0] >= 0) {
-                FD_SET(tt->from_child[0], &readfds);
-                if (tt->from_child[0] > maxfd) maxfd = tt->from_child[0];
-            }
-            for (int m = 0; m < tt->mw_n; ++m) {
-                if (tt->mw_cmds[m].fd[0] >= 0) {
-                    FD_SET(tt->mw_cmds[m].fd[0], &readfds);
-                    if (tt->mw_cmds[m].fd[0] > maxfd) maxfd = tt->mw_cmds[m].fd[0];
-                }
-            }
-        }
-
-        struct timeval tv = {0, 10000};
-        if (maxfd >= 0) {
-            int ready = select(maxfd+1, &readfds, NULL, NULL, &tv);
-            if (ready > 0) {
-                for (int i = 0; i < tab_count; ++i) {
-                    Tab *tt = &tabs[i];
-                    if (tt->from_child[0] >= 0 && FD_ISSET(tt->from_child[0], &readfds)) {
-                        char rbuf[512];
-                        ssize_t rn;
-                        while ((rn = read(tt->from_child[0], rbuf, sizeof(rbuf))) > 0) 
-                        {
-                            append_text(tt, rbuf, (int)rn);
-                        }
-
-                        if (rn == 0) 
-                        {
-                            if (tt->stream_len > 0) {
-                                tt->stream_line[tt->stream_len] = '\0';
-                                if (tt->lines_count >= MAX_LINES) {
-                                    free(tt->lines[0]);
-                                    memmove(&tt->lines[0], &tt->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                                    memmove(&tt->is_command[0], &tt->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                                    tt->lines_count--;
-                                }
-                                tt->lines[tt->lines_count] = strdup(tt->stream_line);
-                                tt->is_command[tt->lines_count++] = 0;
-                                tt->stream_len = 0;
-                                tt->stream_line[0] = '\0';
-                            }
-                            close(tt->from_child[0]);
-                            tt->from_child[0] = -1;
-                            tt->pid = -1;
-                        } else if (rn < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-                            if (tt->stream_len > 0) {
-                                tt->stream_line[tt->stream_len] = '\0';
-                                if (tt->lines_count >= MAX_LINES) {
-                                    free(tt->lines[0]);
-                                    memmove(&tt->lines[0], &tt->lines[1], sizeof(char*) * (MAX_LINES - 1));
-                                    memmove(&tt->is_command[0], &tt->is_command[1], sizeof(int) * (MAX_LINES - 1));
-                                    tt->lines_count--;
-                                }
-                                tt->lines[tt->lines_count] = strdup(tt->stream_line);
-                                tt->is_command[tt->lines_count++] = 0;
-                                tt->stream_len = 0;
-                                tt->stream_line[0] = '\0';
-                            }
-                            close(tt->from_child[0]);
-                            tt->from_child[0] = -1;
-                            tt->pid = -1;
-                        }
-
-                        if (i == active) scroll_to_cursor(tt);
-                    }
-                }
-
-                for (int ti = 0; ti < tab_count; ++ti) {
-                    Tab *tt = &tabs[ti];
-                    if (tt->mw_n > 0) {
-                        for (int m = 0; m < tt->mw_n; ++m) {
-                            int fd = tt->mw_cmds[m].fd[0];
-                            if (fd >= 0 && FD_ISSET(fd, &readfds)) {
-                                char bufm[BUF_SIZE];
-                                ssize_t r = read(fd, bufm, sizeof(bufm));
-                                if (r > 0) {
-                                    char fname[64];
-                                    snprintf(fname, sizeof(fname), ".temp.%d.txt", (int)tt->mw_cmds[m].pid);
-                                    int tf = open(fname, O_WRONLY | O_CREAT | O_APPEND, 0644);
-                                    if (tf >= 0) {
-                                        write(tf, bufm, (size_t)r);
-                                        close(tf);
-                                    }
-
-                                    int pid_for_file = (int)tt->mw_cmds[m].pid;
-                                    int map_index = pid_for_file % PID_OFF_MAP_SIZE;
-                                    off_t prev = pid_offsets[map_index];
-                                    int rf = open(fname, O_RDONLY);
-                                    if (rf >= 0) {
-                                        off_t end = lseek(rf, 0, SEEK_END);
-                                        if (end == -1) end = 0;
-                                        if (end > prev) {
-                                            off_t len = end - prev;
-                                            if (lseek(rf, prev, SEEK_SET) == prev) {
-                                                char *all = malloc((size_t)len + 1);
-                                                if (all) {
-                                                    ssize_t got = read(rf, all, (size_t)len);
-                                                    if (got < 0) got = 0;
-                                                    all[got] = '\0';
-                                                    pid_offsets[map_index] = end;
-
-                                                    time_t now = time(NULL);
-                                                    struct tm *tm_info = localtime(&now);
-                                                    char tstr[64];
-                                                    strftime(tstr, sizeof(tstr), "%Y-%m-%d %H:%M:%S", tm_info);
-                                                    char header[256];
-                                                    snprintf(header, sizeof(header), "\"%s\" , %s :",
-                                                            tt->mw_cmds[m].cmd, tstr);
-
-                                                    if (tt->lines_count >= MAX_LINES) {
-                                                        free(tt->lines[0]);
-                                                        memmove(&tt->lines[0], &tt->lines[1], sizeof(char*)*(MAX_LINES-1));
-                                                        memmove(&tt->is_command[0], &tt->is_command[1], sizeof(int)*(MAX_LINES-1));
-                                                        tt->lines_count--;
-                                                    }
-                                                    tt->lines[tt->lines_count] = strdup(header);
-                                                    tt->is_command[tt->lines_count++] = 0;
-
-                                                    if (tt->lines_count >= MAX_LINES) {
-                                                        free(tt->lines[0]);
-                                                        memmove(&tt->lines[0], &tt->lines[1], sizeof(char*)*(MAX_LINES-1));
-                                                        memmove(&tt->is_command[0], &tt->is_command[1], sizeof(int)*(MAX_LINES-1));
-                                                        tt->lines_count--;
-                                                    }
-                                                    tt->lines[tt->lines_count] = strdup("----------------------------------------------------");
-                                                    tt->is_command[tt->lines_count++] = 0;
-
-                                                    append_text(tt, all, (int)strlen(all));
-
-                                                    if (tt->lines_count >= MAX_LINES) {
-                                                        free(tt->lines[0]);
-                                                        memmove(&tt->lines[0], &tt->lines[1], sizeof(char*)*(MAX_LINES-1));
-                                                        memmove(&tt->is_command[0], &tt->is_command[1], sizeof(int)*(MAX_LINES-1));
-                                                        tt->lines_count--;
-                                                    }
-                                                    tt->lines[tt->lines_count] = strdup("----------------------------------------------------");
-                                                    tt->is_command[tt->lines_count++] = 0;
-
-                                                    free(all);
-                                                }
-                                            }
-                                        }
-                                        close(rf);
-                                    }
-                                    if (ti == active) scroll_to_cursor(tt);
-                                } 
-                                else if (r == 0) 
-                                {
-                                    close(fd);
-                                    tt->mw_cmds[m].fd[0] = -1;
-                                } 
-                                else if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK) 
-                                {
-                                    close(fd);
-                                    tt->mw_cmds[m].fd[0] = -1;
-                                }
-                            }
-                        }
-
-                        int openFound = 0;
-                        for (int m = 0; m < tt->mw_n; ++m)
-                            if (tt->mw_cmds[m].fd[0] >= 0) openFound = 1;
-
-                        if (!openFound) 
-                        {
-                            for (int m = 0; m < tt->mw_n; ++m) 
-                            {
-                                if (tt->mw_cmds[m].pid > 0) waitpid(tt->mw_cmds[m].pid, NULL, 0);
-                                if (tt->mw_cmds[m].fd[0] >= 0) close(tt->mw_cmds[m].fd[0]);
-                                if (tt->mw_cmds[m].fd[1] >= 0) close(tt->mw_cmds[m].fd[1]);
-                                if (tt->mw_cmds[m].cmd) free(tt->mw_cmds[m].cmd);
-                                tt->mw_cmds[m].cmd = NULL;
-                                tt->mw_cmds[m].fd[0] = -1;
-                                tt->mw_cmds[m].fd[1] = -1;
-                                tt->mw_cmds[m].pid = -1;
-                            }
-                            tt->mw_n = 0;
-                            tt->mw_maxfd = -1;
-                        }
-                    }
-                }
-            }
-        } 
-        else 
-        {
-            nanosleep(&ts, NULL);
-        }
-
-        blink_counter++;
-        if (blink_counter % 10 == 0) cursor_visible = !cursor_visible;
-        draw_ui(display, win, gc, font, &tabs[active], active, tab_count,
-                search_mode, search_buf, search_len, search_cursor);
-    }
-
-    if (xic) XDestroyIC(xic);
-    if (xim) XCloseIM(xim);
-    XFreeFont(display, font);
-    XCloseDisplay(display);
-    return 0;
-}
\ No newline at end of file
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <glob.h>
+#include <limits.h>
+#include <wordexp.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <pwd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <wchar.h>
+#include <X11/Xutil.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <spawn.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define WIDTH 900
+#define HEIGHT 600
+#define MAX_TABS 100
+#define MAX_LINES 1000
+#define MAX_LINE_LEN 4096
+
+#define LEFT_MARGIN 6
+#define TOP_MARGIN 20
+#define SCROLL_STEP 3
+#define HISTORY_MAX 10000
+#define HISTORY_SHOW 1000
+#define BUF_SIZE 1024
+
+#define MW_RING_SIZE (64 * 1024)
+#define MW_RUN_MARKS 16
+
+/* Where a run of the command started in the ring, and when. */
+typedef struct {
+    uint64_t at;
+    time_t when;
+} MWRunMark;
+
+/* Recent output of one watched command. head counts every byte ever
+ * written; spilled is how far the log writer has got. runs counts the
+ * launches recorded in marks and runs_spilled the ones the log writer has
+ * given a header; if it falls MW_RUN_MARKS behind, the oldest boundaries
+ * are merged. The lock is only contended when a spill log is attached. */
+typedef struct {
+    char *buf;
+    size_t size;
+    uint64_t head;
+    uint64_t spilled;
+    uint64_t dropped;
+    MWRunMark marks[MW_RUN_MARKS];
+    uint64_t runs;
+    uint64_t runs_spilled;
+    pthread_mutex_t lock;
+} MWRing;
+
+/* Log-linear latency histogram in the HdrHistogram style: exact below
+ * HIST_SUB microseconds, then HIST_SUB/2 sub-buckets per power of two,
+ * which keeps every recorded value within about 3% of its bucket. */
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_MSB 40
+#define HIST_BUCKETS ((HIST_MAX_MSB - HIST_SUB_BITS + 2) * (HIST_SUB / 2) + HIST_SUB / 2)
+
+typedef struct {
+    uint32_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+} LatencyHist;
+
+/* One watched command. While a run is in flight pid and fd describe it;
+ * between runs the command sits in the scheduler's timer wheel. */
+typedef struct MWCommand {
+    char *cmd;
+    char **argv;
+    char *argbuf;
+    int fd;
+    pid_t pid;
+    MWRing *ring;
+    struct MWSession *session;
+    int interval_ms;
+    uint64_t due_tick;
+    struct MWCommand *wnext;
+    struct MWCommand *wprev;
+    int in_wheel;
+    int in_run;
+    char *partial;
+    int partial_len;
+    unsigned long runs;
+    unsigned long skipped;
+    uint64_t *prev_hash;
+    int prev_n;
+    int prev_cap;
+    uint64_t *cur_hash;
+    int cur_n;
+    int cur_cap;
+    int changed;
+    char *unchanged_line;
+    unsigned long unchanged_runs;
+    char **pane_lines;
+    int pane_n;
+    char **pane_next;
+    int pane_next_n;
+    int pane_next_cap;
+    time_t pane_time;
+    int pane_dirty;
+    uint64_t run_start_us;
+    uint64_t run_bytes;
+    int run_status;
+    int run_reaped;
+    struct rusage run_usage;
+    LatencyHist *hist;
+    unsigned long completed;
+    unsigned long failed;
+    int last_status;
+    uint64_t last_bytes;
+    uint64_t total_bytes;
+    uint64_t cpu_us;
+    int spawn_errno;
+} MWCommand;
+
+#define MW_DEFAULT_INTERVAL_MS 2000
+#define MW_DEFAULT_MAX_RUNNING 8
+#define MW_PANE_MAX_LINES 256
+
+/* A multiWatch invocation: its commands plus the limits they run under. */
+typedef struct MWSession {
+    MWCommand *cmds;
+    int n;
+    int running;
+    int max_running;
+    int jitter_ms;
+    int diff;
+    int panes;
+    struct MWSpill *spill;
+    char cwd[PATH_MAX];
+} MWSession;
+
+/* One pipeline started from a tab, in the foreground or with &. Each job
+ * assembles its own output lines so concurrent jobs never split each
+ * other's lines; pids holds its spawned stages until they are reaped. */
+enum { JOB_RUNNING, JOB_STOPPED };
+
+typedef struct Job {
+    int id;
+    pid_t pgid;
+    pid_t last_pid;
+    pid_t *pids;
+    int npids;
+    int nlive;
+    int in_fd;
+    int out_fd;
+    int state;
+    int status;
+    int background;
+    uint64_t cpu_us;
+    long maxrss_kb;
+    char *cmd;
+    struct IoStream *io;
+    char stream_line[MAX_LINE_LEN];
+    int  stream_len;
+} Job;
+
+typedef struct {
+    Job **jobs;
+    int  njobs;
+    int  jobs_cap;
+    Job *fg;
+    char *lines[MAX_LINES];
+    int  is_command[MAX_LINES];
+    int  lines_count;
+    char current_line[MAX_LINE_LEN];
+    int  current_len;
+    int  cursor_pos;
+    char cwd[PATH_MAX];
+    int scroll_offset;
+    char stream_line[MAX_LINE_LEN];
+    int  stream_len;
+    MWSession *mw;
+
+    char **autocomplete_matches;
+    int  autocomplete_count;
+    int  autocomplete_cap;
+    struct CompleteReq *autocomplete_req;
+    int  autocomplete_start;
+    int  autocomplete_pos;
+    int  autocomplete_cmdpos;
+    struct ParsedLine *run_line;
+    int  run_next;
+    int  run_status;
+    /* Bytes held by lines[], NULs included; kept by every site that
+     * stores or frees a line so the HUD need not walk scrollback. */
+    size_t scroll_bytes;
+    /* Output taken in and lines added. Only the UI thread writes them
+     * (see perf_add); any thread may read them. */
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t lines_in;
+} Tab;
+
+/* Bumps a counter that has a single writer: a relaxed load and store, so
+ * hot paths pay for no locked instruction and readers still never see a
+ * torn value. */
+static inline void perf_add(atomic_uint_fast64_t *c, uint64_t n)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/* Span tracing (--trace FILE). Any thread claims a slot in a fixed ring
+ * with one atomic add and publishes it with a sequence number; the ring
+ * keeps the newest TRACE_RING_SLOTS spans and is written out at exit as
+ * Chrome trace-event JSON, which Perfetto and chrome://tracing open.
+ * trace_on is set before any thread starts, so when tracing is off each
+ * probe costs one predictable branch. */
+#define TRACE_RING_SLOTS (1 << 16)
+#define TRACE_MAX_THREADS 64
+
+typedef struct {
+    atomic_uint_fast64_t seq;
+    const char *name;
+    uint64_t start_us;
+    uint64_t dur_us;
+    const char *k1;
+    const char *k2;
+    int64_t v1;
+    int64_t v2;
+    int tid;
+} TraceSpan;
+
+typedef struct {
+    int tid;
+    const char *name;
+} TraceThread;
+
+static int trace_on = 0;
+static TraceSpan *trace_ring;
+static atomic_uint_fast64_t trace_head;
+static TraceThread trace_threads[TRACE_MAX_THREADS];
+static atomic_int trace_nthreads;
+static char *trace_path;
+static _Thread_local int trace_tid;
+
+static uint64_t monotonic_us(void);
+
+static inline uint64_t trace_begin(void)
+{
+    return trace_on ? monotonic_us() : 0;
+}
+
+static void trace_record(const char *name, uint64_t start, const char *k1, int64_t v1, const char *k2, int64_t v2)
+{
+    if (!trace_tid) trace_tid = (int)gettid();
+    uint64_t i = atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+    TraceSpan *sp = &trace_ring[i & (TRACE_RING_SLOTS - 1)];
+    atomic_store_explicit(&sp->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    sp->name = name;
+    sp->start_us = start;
+    sp->dur_us = monotonic_us() - start;
+    sp->k1 = k1;
+    sp->v1 = v1;
+    sp->k2 = k2;
+    sp->v2 = v2;
+    sp->tid = trace_tid;
+    atomic_store_explicit(&sp->seq, i + 1, memory_order_release);
+}
+
+/* Ends a span begun with trace_begin; k1/k2 name up to two integer args. */
+#define trace_end(name, start, k1, v1, k2, v2) \
+    do { if (trace_on) trace_record(name, start, k1, v1, k2, v2); } while (0)
+
+/* Labels the calling thread in the trace. */
+static void trace_thread(const char *name)
+{
+    if (!trace_on) return;
+    if (!trace_tid) trace_tid = (int)gettid();
+    int n = atomic_fetch_add(&trace_nthreads, 1);
+    if (n >= TRACE_MAX_THREADS) return;
+    trace_threads[n].name = name;
+    trace_threads[n].tid = trace_tid;
+}
+
+static void trace_json_arg(FILE *f, const char *k, int64_t v, int *first)
+{
+    if (!k) return;
+    fprintf(f, "%s\"%s\":%lld", *first ? "" : ",", k, (long long)v);
+    *first = 0;
+}
+
+/* Writes what the ring still holds; spans being written are skipped. */
+static void trace_flush(void)
+{
+    FILE *f = fopen(trace_path, "w");
+    if (!f) 
+    {
+        perror(trace_path);
+        return;
+    }
+    uint64_t head = atomic_load(&trace_head);
+    uint64_t first = head > TRACE_RING_SLOTS ? head - TRACE_RING_SLOTS : 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"myterm\"}}", (int)getpid());
+    int nthreads = atomic_load(&trace_nthreads);
+    for (int i = 0; i < nthreads && i < TRACE_MAX_THREADS; ++i)
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                (int)getpid(), trace_threads[i].tid, trace_threads[i].name);
+    for (uint64_t i = first; i < head; ++i) 
+    {
+        TraceSpan *sp = &trace_ring[i & (TRACE_RING_SLOTS - 1)];
+        if (atomic_load_explicit(&sp->seq, memory_order_acquire) != i + 1) continue;
+        TraceSpan c = { 0, sp->name, sp->start_us, sp->dur_us, sp->k1, sp->k2, sp->v1, sp->v2, sp->tid };
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&sp->seq, memory_order_relaxed) != i + 1) continue;
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d,\"args\":{",
+                c.name, (unsigned long long)c.start_us, (unsigned long long)c.dur_us, (int)getpid(), c.tid);
+        int firstarg = 1;
+        trace_json_arg(f, c.k1, c.v1, &firstarg);
+        trace_json_arg(f, c.k2, c.v2, &firstarg);
+        fprintf(f, "}}");
+    }
+    fprintf(f, "\n]}\n");
+    if (fclose(f) != 0) perror(trace_path);
+    else if (head > TRACE_RING_SLOTS)
+        fprintf(stderr, "%s: kept the last %d of %llu spans\n", trace_path, TRACE_RING_SLOTS, (unsigned long long)head);
+}
+
+/* Turns tracing on for the whole run; call before starting any thread. */
+static int trace_start(const char *path)
+{
+    trace_ring = calloc(TRACE_RING_SLOTS, sizeof(TraceSpan));
+    trace_path = strdup(path);
+    if (!trace_ring || !trace_path) 
+    {
+        free(trace_ring);
+        free(trace_path);
+        return -1;
+    }
+    trace_on = 1;
+    trace_thread("ui");
+    atexit(trace_flush);
+    return 0;
+}
+
+static char *history[HISTORY_MAX];
+static int history_count = 0;
+static int history_start = 0;
+static char history_path[PATH_MAX];
+int cursor_visible = 1;
+static XFontSet fontset = NULL;
+static int font_ascent = 13;
+static int font_descent = 5;
+static int FONT_HEIGHT;
+
+static void make_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) return;
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void scroll_to_cursor(Tab *t);
+static void append_text(Tab *t, const char *s, int n);
+struct Renderer;
+static void draw_ui(struct Renderer *r, Tab *t,
+                    int active, int tab_count, int search_mode, char *search_buf, int search_len, int search_cursor);
+
+static int is_utf8_continuation(unsigned char c) 
+{
+    return (c & 0xC0) == 0x80;
+}
+static int utf8_text_width(XFontStruct *fallback_font, const char *text, int len)
+{
+    if (!text || len <= 0) return 0;
+    if (fontset) 
+    {
+        XRectangle ink, logical;
+        Xutf8TextExtents(fontset, text, len, &ink, &logical);
+        return logical.width;
+    }
+    if (fallback_font) 
+    {
+        return XTextWidth(fallback_font, text, len);
+    }
+    return 0;
+}
+/* Lines dropped at once when scrollback is full, so a flood of output
+ * pays for one memmove per batch rather than one per line. */
+#define SCROLLBACK_TRIM (MAX_LINES / 8)
+
+/* Where headless mode copies every line a tab prints, or NULL. */
+static FILE *line_sink = NULL;
+/* Set in headless mode, where no keyboard can feed a job's stdin. */
+static int jobs_stdin_null = 0;
+
+/* A diff-mode multiWatch command keeps a pointer to its "unchanged"
+ * marker line so it can update it in place; drop it before the line is
+ * freed. */
+static void mw_forget_line(Tab *t, const char *line)
+{
+    for (int m = 0; t->mw && m < t->mw->n; ++m)
+        if (t->mw->cmds[m].unchanged_line == line) t->mw->cmds[m].unchanged_line = NULL;
+}
+
+static size_t line_bytes(const char *line)
+{
+    return line ? strlen(line) + 1 : 0;
+}
+
+static void push_tab_line(Tab *t, const char *line, int is_command)
+{
+    if (t->lines_count >= MAX_LINES) 
+    {
+        for (int i = 0; i < SCROLLBACK_TRIM; ++i) 
+        {
+            mw_forget_line(t, t->lines[i]);
+            t->scroll_bytes -= line_bytes(t->lines[i]);
+            free(t->lines[i]);
+        }
+        memmove(&t->lines[0], &t->lines[SCROLLBACK_TRIM], sizeof(char*) * (MAX_LINES - SCROLLBACK_TRIM));
+        memmove(&t->is_command[0], &t->is_command[SCROLLBACK_TRIM], sizeof(int) * (MAX_LINES - SCROLLBACK_TRIM));
+        t->lines_count -= SCROLLBACK_TRIM;
+    }
+    t->lines[t->lines_count] = strdup(line ? line : "");
+    t->scroll_bytes += line_bytes(t->lines[t->lines_count]);
+    t->is_command[t->lines_count] = is_command;
+    t->lines_count++;
+    perf_add(&t->lines_in, 1);
+    if (line_sink) 
+    {
+        fputs(line ? line : "", line_sink);
+        fputc('\n', line_sink);
+    }
+}
+
+static void push_line(Tab *t, const char *line) 
+{
+    push_tab_line(t, line, 0);
+}
+/* Renders echo's quoted argument into out: a literal "\n\" breaks the
+ * line, and each line is trimmed of surrounding spaces. Returns an error
+ * message, or NULL on success. */
+static const char *echo_render(const char *input, char *out, size_t cap)
+{
+    const char *p = input;
+    while (*p && !isspace((unsigned char)*p)) p++;
+    while (*p && isspace((unsigned char)*p)) p++;
+    if (*p != '"') return "Error: echo requires a quoted string.";
+    p++;
+    const char *start = p;
+    const char *end = strrchr(start, '"');
+    if (!end) return "Error: unclosed quote in echo command.";
+    int len = (int)(end - start);
+    if (len > MAX_LINE_LEN - 1) len = MAX_LINE_LEN - 1;
+    char content[MAX_LINE_LEN];
+    strncpy(content, start, len);
+    content[len] = '\0';
+    char output[MAX_LINE_LEN];
+    int out_idx = 0;
+    int in_idx = 0;
+    while (in_idx < len && out_idx < MAX_LINE_LEN - 1) 
+    {
+        if (content[in_idx] == '\n' || content[in_idx] == '\r') 
+        {
+            in_idx++;
+            continue;
+        }
+        if (content[in_idx] == '\\' &&
+            in_idx + 2 < len &&
+            content[in_idx + 1] == 'n' &&
+            content[in_idx + 2] == '\\') {
+            if (out_idx > 0 && output[out_idx - 1] == ' ')
+                out_idx--;
+            output[out_idx++] = '\n';
+            in_idx += 3;
+            continue;
+        }
+        output[out_idx++] = content[in_idx++];
+    }
+    output[out_idx] = '\0';
+
+    size_t o = 0;
+    char *line_start = output;
+    for (;;) 
+    {
+        char *nl = strchr(line_start, '\n');
+        if (nl) *nl = '\0';
+        char *trim = line_start;
+        while (*trim == ' ') trim++;
+        char *endp = trim + strlen(trim);
+        while (endp > trim && endp[-1] == ' ') endp--;
+        size_t n = (size_t)(endp - trim);
+        if (o + n + 2 > cap) n = cap > o + 2 ? cap - o - 2 : 0;
+        memcpy(out + o, trim, n);
+        o += n;
+        if (!nl) break;
+        out[o++] = '\n';
+        line_start = nl + 1;
+    }
+    out[o] = '\0';
+    return NULL;
+}
+
+static void custom_echo_handler(Tab *t, const char *input)
+{
+    char output[MAX_LINE_LEN];
+    const char *err = echo_render(input, output, sizeof(output));
+    if (err) 
+    {
+        push_line(t, err);
+        return;
+    }
+    char *line_start = output;
+    char *nl;
+    while ((nl = strchr(line_start, '\n')) != NULL) 
+    {
+        *nl = '\0';
+        push_line(t, line_start);
+        line_start = nl + 1;
+    }
+    push_line(t, line_start);
+    scroll_to_cursor(t);
+}
+
+static int utf8_char_len(unsigned char first_byte) 
+{
+    if ((first_byte & 0x80) == 0) return 1;
+    if ((first_byte & 0xE0) == 0xC0) return 2;
+    if ((first_byte & 0xF0) == 0xE0) return 3;
+    if ((first_byte & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+static void push_command_line(Tab *t, const char *line) 
+{
+    push_tab_line(t, line, 1);
+}
+
+static const char *get_last_user_command(Tab *t) 
+{
+    if (!t) return NULL;
+    for (int i = t->lines_count - 1; i >= 0; --i) {
+        if (t->is_command[i] == 1 && t->lines[i] && t->lines[i][0] != '\0')
+            return t->lines[i];
+    }
+    return NULL;
+}
+
+static void debug_print_argv(char *argv[], int argc) 
+{
+    fprintf(stderr, "DEBUG: argc=%d\n", argc);
+    for (int i = 0; i < argc; ++i) {
+        if (!argv[i]) { fprintf(stderr, "DEBUG: argv[%d]=NULL\n", i); continue; }
+        fprintf(stderr, "DEBUG: argv[%d]=\"", i);
+        for (size_t j = 0; j < strlen(argv[i]); ++j) {
+            unsigned char c = (unsigned char)argv[i][j];
+            if (c >= 32 && c < 127) fputc(c, stderr);
+            else if (c == '\n') fputs("\\n", stderr);
+            else if (c == '\t') fputs("\\t", stderr);
+            else fprintf(stderr, "\\x%02X", c);
+        }
+        fputs("\"\n", stderr);
+    }
+}
+static void handle_echo(Tab *t, char *argv[], int argc) 
+{
+    if (argc <= 1) 
+    {
+        push_line(t, "");
+        scroll_to_cursor(t);
+        return;
+    }
+    size_t total = 0;
+    for (int i = 1; i < argc; i++) total += strlen(argv[i]) + 1;
+    char *full = malloc(total + 1);
+    if (!full) return;
+    full[0] = '\0';
+    for (int i = 1; i < argc; i++) 
+    {
+        if (i > 1) strcat(full, " ");
+        strcat(full, argv[i]);
+    }
+    char *line_start = full;
+    char *p = full;
+    while (*p) 
+    {
+        if (*p == '\n') 
+        {
+            *p = '\0';
+            push_line(t, line_start);
+            line_start = p + 1;
+        }
+        p++;
+    }
+    if (*line_start) push_line(t, line_start);
+    free(full);
+    scroll_to_cursor(t);
+}
+static int parse_command_line(const char *line, char *argv[], int max_args, char **allocated_buf) 
+{
+    if (!line || !argv || max_args <= 0) return 0;
+    size_t len = strlen(line);
+    char *buf = malloc(len + 1);
+    if (!buf) return 0;
+    *allocated_buf = buf;
+    int argc = 0;
+    const char *p = line;
+    while (*p && argc < max_args - 1) 
+    {
+        while (*p == ' ' || *p == '\t') p++;
+        if (!*p) break;
+        argv[argc++] = buf;
+        if (*p == '"' || *p == '\'') 
+        {
+            char quote = *p++;
+            while (*p && *p != quote) {
+                if (*p == '\\' && *(p+1)) 
+                {
+                    p++;
+                    switch (*p) 
+                    {
+                        case 'n': *buf++ = '\n'; break;
+                        case 't': *buf++ = '\t'; break;
+                        case 'r': *buf++ = '\r'; break;
+                        case '\\': *buf++ = '\\'; break;
+                        case '"': *buf++ = '"'; break;
+                        case '\'': *buf++ = '\''; break;
+                        default: *buf++ = *p; break;
+                    }
+                    p++;
+                } 
+                else 
+                {
+                    *buf++ = *p++;
+                }
+            }
+            if (*p == quote) p++;
+        } 
+        else 
+        {
+            while (*p && *p != ' ' && *p != '\t') 
+            {
+                if (*p == '\\' && *(p+1)) 
+                {
+                    p++;
+                    *buf++ = *p++;
+                } 
+                else 
+                {
+                    *buf++ = *p++;
+                }
+            }
+        }
+        *buf++ = '\0';
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+void scroll_to_cursor(Tab *t) 
+{
+    int max_visible = (HEIGHT - TOP_MARGIN - FONT_HEIGHT) / FONT_HEIGHT;
+    if (max_visible < 1) max_visible = 1;
+    if (t->lines_count > max_visible) 
+    {
+        t->scroll_offset = t->lines_count - max_visible;
+    } 
+    else 
+    {
+        t->scroll_offset = 0;
+    }
+}
+void scroll_up(Tab *t) 
+{
+    if (t->scroll_offset > 0)
+        t->scroll_offset -= SCROLL_STEP;
+    if (t->scroll_offset < 0) t->scroll_offset = 0;
+}
+void scroll_down(Tab *t) 
+{
+    int max_visible = (HEIGHT - TOP_MARGIN - FONT_HEIGHT) / FONT_HEIGHT;
+    if (max_visible < 1) max_visible = 1;
+    int max_offset = (t->lines_count > max_visible) ? (t->lines_count - max_visible) : 0;
+    if (t->scroll_offset < max_offset)
+        t->scroll_offset += SCROLL_STEP;
+    if (t->scroll_offset > max_offset) t->scroll_offset = max_offset;
+}
+
+static void load_history_file(void) 
+{
+    struct passwd *pw = getpwuid(getuid());
+    const char *home = pw ? pw->pw_dir : getenv("HOME");
+    if (!home) return;
+    snprintf(history_path, sizeof(history_path), "%s/.myterm_history", home);
+    FILE *f = fopen(history_path, "r");
+    if (!f) return;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) 
+    {
+        size_t L = strlen(line);
+        if (L && line[L-1] == '\n') line[L-1] = '\0';
+        if (history_count < HISTORY_MAX) {
+            history[history_count++] = strdup(line);
+        } 
+        else 
+        {
+            free(history[history_start]);
+            history[history_start] = strdup(line);
+            history_start = (history_start + 1) % HISTORY_MAX;
+        }
+    }
+    fclose(f);
+}
+static void append_history_file(const char *cmd) 
+{
+    if (history_path[0] == '\0' || !cmd || cmd[0]=='\0') return;
+    FILE *f = fopen(history_path, "a");
+    if (!f) return;
+    fprintf(f, "%s\n", cmd);
+    fclose(f);
+}
+static void add_history(const char *cmd) 
+{
+    if (!cmd || cmd[0]=='\0') return;
+    if (history_count < HISTORY_MAX) 
+    {
+        history[history_count++] = strdup(cmd);
+    }
+    else 
+    {
+        free(history[history_start]);
+        history[history_start] = strdup(cmd);
+        history_start = (history_start + 1) % HISTORY_MAX;
+    }
+    append_history_file(cmd);
+}
+static void show_history_in_tab(Tab *t) 
+{
+    if (history_count == 0) 
+    {
+        push_line(t, "(no history)");
+        scroll_to_cursor(t);
+        return;
+    }
+    int shown = 0;
+    for (int i = history_count - 1; i >= 0 && shown < HISTORY_SHOW; --i, ++shown) 
+    {
+        int idx = i % HISTORY_MAX;
+        if (!history[idx]) continue;
+        push_line(t, history[idx]);
+    }
+    scroll_to_cursor(t);
+}
+
+static int longest_common_substring_len(const char *a, const char *b) 
+{
+    int la = (int)strlen(a), lb = (int)strlen(b);
+    if (la == 0 || lb == 0) return 0;
+    int *prev = calloc(lb+1, sizeof(int));
+    int *cur = calloc(lb+1, sizeof(int));
+    int best = 0;
+    for (int i = 1; i <= la; ++i) 
+    {
+        for (int j = 1; j <= lb; ++j) 
+        {
+            if (a[i-1] == b[j-1]) 
+            {
+                cur[j] = prev[j-1] + 1;
+                if (cur[j] > best) best = cur[j];
+            } else cur[j] = 0;
+        }
+        int *tmp = prev; prev = cur; cur = tmp;
+        memset(cur, 0, (lb+1)*sizeof(int));
+    }
+    free(prev); free(cur);
+    return best;
+}
+static void perform_history_search_and_print(Tab *t, const char *term) 
+{
+    if (!term || term[0] == '\0') 
+    {
+        push_line(t, "Empty search term");
+        scroll_to_cursor(t);
+        return;
+    }
+    for (int i = history_count - 1; i >= 0; --i) 
+    {
+        int idx = i % HISTORY_MAX;
+        if (history[idx] && strcmp(history[idx], term) == 0) 
+        {
+            push_line(t, history[idx]);
+            scroll_to_cursor(t);
+            return;
+        }
+    }
+    int best_len = 0;
+    for (int i = 0; i < history_count; ++i) 
+    {
+        int idx = i % HISTORY_MAX;
+        if (!history[idx]) continue;
+        int lcs = longest_common_substring_len(term, history[idx]);
+        if (lcs > best_len) best_len = lcs;
+    }
+
+    if (best_len <= 2) 
+    {
+        push_line(t, "No match for search term in history");
+        scroll_to_cursor(t);
+        return;
+    }
+    for (int i = history_count - 1; i >= 0; --i) 
+    {
+        int idx = i % HISTORY_MAX;
+        if (!history[idx]) continue;
+        int lcs = longest_common_substring_len(term, history[idx]);
+        if (lcs == best_len) {
+            push_line(t, history[idx]);
+        }
+    }
+    scroll_to_cursor(t);
+}
+
+/* Frecency store for visited directories and chosen completions, kept in
+ * ~/.myterm_frecency and mapped shared so lookups never touch the disk.
+ * Layout: header, an open-addressed slot table (power of two), then a
+ * heap of NUL-terminated paths referenced by offset. */
+#define FRECENCY_MAGIC 0x5246544dU
+#define FRECENCY_MIN_SLOTS 1024
+#define FRECENCY_MAX_TOTAL 100000.0
+
+typedef struct {
+    uint32_t magic;
+    uint32_t slots;
+    uint32_t used;
+    uint32_t str_used;
+    uint32_t str_cap;
+    uint32_t reserved;
+    double total_rank;
+} FrecencyHeader;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t str_off;
+    float rank;
+    uint32_t reserved;
+    int64_t last;
+} FrecencySlot;
+
+static FrecencyHeader *frec_map = NULL;
+static size_t frec_map_len = 0;
+static int frec_fd = -1;
+/* Guards the map and the flock, which completion threads read and the
+ * writer thread updates. The UI thread only queues updates (frecency_note)
+ * so a slow $HOME never stalls it. */
+static pthread_mutex_t frec_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define FREC_SLOTS(h) ((FrecencySlot *)((char *)(h) + sizeof(FrecencyHeader)))
+#define FREC_STRS(h) ((char *)FREC_SLOTS(h) + sizeof(FrecencySlot) * (h)->slots)
+
+static uint32_t frecency_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h ? h : 1;
+}
+
+static int frecency_map_file(size_t len)
+{
+    if (frec_map) munmap(frec_map, frec_map_len);
+    frec_map = NULL;
+    frec_map_len = 0;
+    if (ftruncate(frec_fd, (off_t)len) != 0) return -1;
+    void *m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, frec_fd, 0);
+    if (m == MAP_FAILED) return -1;
+    frec_map = m;
+    frec_map_len = len;
+    return 0;
+}
+
+/* Another MyTerm may have rewritten the file, so nothing in the header is
+ * trusted until it is checked against the size we have mapped. */
+static int frecency_valid(const FrecencyHeader *h)
+{
+    return h && frec_map_len >= sizeof(FrecencyHeader) && h->magic == FRECENCY_MAGIC &&
+           h->slots >= FRECENCY_MIN_SLOTS && (h->slots & (h->slots - 1)) == 0 &&
+           h->used < h->slots && h->str_used <= h->str_cap &&
+           sizeof(FrecencyHeader) + sizeof(FrecencySlot) * (size_t)h->slots + h->str_cap <= frec_map_len;
+}
+
+/* The path stored at off, or NULL if off is outside the used heap or the
+ * string is not terminated inside it. */
+static const char *frecency_str(const FrecencyHeader *h, uint32_t off)
+{
+    if (off >= h->str_used) return NULL;
+    const char *p = FREC_STRS(h) + off;
+    return memchr(p, '\0', h->str_used - off) ? p : NULL;
+}
+
+static FrecencySlot *frecency_find(FrecencyHeader *h, const char *path, uint32_t hash, int *found)
+{
+    FrecencySlot *slots = FREC_SLOTS(h);
+    uint32_t mask = h->slots - 1;
+    uint32_t i = hash & mask;
+    *found = 0;
+    for (uint32_t probes = 0; probes < h->slots; ++probes, i = (i + 1) & mask)
+    {
+        FrecencySlot *sl = &slots[i];
+        if (sl->hash == 0) return sl;
+        const char *s = sl->hash == hash ? frecency_str(h, sl->str_off) : NULL;
+        if (s && strcmp(s, path) == 0) { *found = 1; return sl; }
+    }
+    return NULL;
+}
+
+/* Rewrites the table, scaling every rank and dropping entries that fall
+ * below 1. Also used to grow the slot table or the string heap. */
+static int frecency_rebuild(double scale, size_t extra_str)
+{
+    FrecencyHeader *old = frec_map;
+    uint32_t n = 0;
+    size_t strs_needed = extra_str;
+    FrecencySlot *keep = NULL;
+    char *oldstrs = NULL;
+    if (frecency_valid(old))
+    {
+        keep = malloc(sizeof(FrecencySlot) * (old->used + 1));
+        oldstrs = malloc(old->str_used + 1);
+        if (!keep || !oldstrs) { free(keep); free(oldstrs); return -1; }
+        memcpy(oldstrs, FREC_STRS(old), old->str_used);
+        FrecencySlot *slots = FREC_SLOTS(old);
+        for (uint32_t i = 0; i < old->slots; ++i)
+        {
+            if (slots[i].hash == 0 || !frecency_str(old, slots[i].str_off)) continue;
+            FrecencySlot e = slots[i];
+            e.rank = (float)(e.rank * scale);
+            if (e.rank < 1.0f) continue;
+            if (n > old->used) break;
+            keep[n++] = e;
+            strs_needed += strlen(oldstrs + e.str_off) + 1;
+        }
+    }
+
+    uint32_t slots_n = FRECENCY_MIN_SLOTS;
+    while (slots_n < (n + 1) * 2) slots_n *= 2;
+    size_t str_cap = strs_needed * 2 < 4096 ? 4096 : strs_needed * 2;
+    size_t len = sizeof(FrecencyHeader) + sizeof(FrecencySlot) * slots_n + str_cap;
+    if (frecency_map_file(len) != 0) { free(keep); free(oldstrs); return -1; }
+
+    FrecencyHeader *h = frec_map;
+    memset(h, 0, sizeof(FrecencyHeader) + sizeof(FrecencySlot) * slots_n);
+    h->magic = FRECENCY_MAGIC;
+    h->slots = slots_n;
+    h->str_cap = (uint32_t)str_cap;
+    char *strs = FREC_STRS(h);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const char *path = oldstrs + keep[i].str_off;
+        size_t plen = strlen(path) + 1;
+        int found;
+        FrecencySlot *sl = frecency_find(h, path, keep[i].hash, &found);
+        *sl = keep[i];
+        sl->str_off = h->str_used;
+        memcpy(strs + h->str_used, path, plen);
+        h->str_used += (uint32_t)plen;
+        h->used++;
+        h->total_rank += sl->rank;
+    }
+    free(keep);
+    free(oldstrs);
+    return 0;
+}
+
+static void frecency_open(void)
+{
+    struct passwd *pw = getpwuid(getuid());
+    const char *home = pw ? pw->pw_dir : getenv("HOME");
+    if (!home) return;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/.myterm_frecency", home);
+    frec_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (frec_fd < 0) return;
+
+    flock(frec_fd, LOCK_EX);
+    struct stat st;
+    int ok = 0;
+    if (fstat(frec_fd, &st) == 0 && (size_t)st.st_size >= sizeof(FrecencyHeader) &&
+        frecency_map_file((size_t)st.st_size) == 0)
+    {
+        ok = frecency_valid(frec_map);
+    }
+    if (!ok)
+    {
+        if (frec_map) munmap(frec_map, frec_map_len);
+        frec_map = NULL;
+        frec_map_len = 0;
+        if (frecency_rebuild(1.0, 0) != 0) { close(frec_fd); frec_fd = -1; }
+    }
+    if (frec_fd >= 0) flock(frec_fd, LOCK_UN);
+}
+
+/* Picks up a resize done by another MyTerm sharing the file. Call with
+ * the file locked. */
+static void frecency_sync(void)
+{
+    struct stat st;
+    if (fstat(frec_fd, &st) != 0) return;
+    if (frec_map && (size_t)st.st_size == frec_map_len) return;
+    if (frec_map) munmap(frec_map, frec_map_len);
+    frec_map = NULL;
+    frec_map_len = 0;
+    if ((size_t)st.st_size < sizeof(FrecencyHeader)) return;
+    void *m = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, frec_fd, 0);
+    if (m == MAP_FAILED) return;
+    frec_map = m;
+    frec_map_len = (size_t)st.st_size;
+}
+
+/* Readers hold LOCK_SH so no other MyTerm can truncate or rewrite the
+ * table under them. Returns the header, or NULL (still locked) if there
+ * is nothing valid to read. */
+static FrecencyHeader *frecency_read_begin(void)
+{
+    pthread_mutex_lock(&frec_lock);
+    if (frec_fd < 0) return NULL;
+    flock(frec_fd, LOCK_SH);
+    frecency_sync();
+    return frecency_valid(frec_map) ? frec_map : NULL;
+}
+
+static void frecency_read_end(void)
+{
+    if (frec_fd >= 0) flock(frec_fd, LOCK_UN);
+    pthread_mutex_unlock(&frec_lock);
+}
+
+/* Call with frec_lock held. */
+static void frecency_add(const char *path)
+{
+    if (frec_fd < 0 || !path || !path[0]) return;
+    flock(frec_fd, LOCK_EX);
+    frecency_sync();
+    size_t plen = strlen(path) + 1;
+    FrecencyHeader *h = frec_map;
+    if (!frecency_valid(h) || (h->used + 1) * 4 > h->slots * 3 || h->str_used + plen > h->str_cap)
+    {
+        if (frecency_rebuild(1.0, plen) != 0) { flock(frec_fd, LOCK_UN); return; }
+        h = frec_map;
+    }
+    uint32_t hash = frecency_hash(path);
+    int found;
+    FrecencySlot *sl = frecency_find(h, path, hash, &found);
+    if (!sl) { flock(frec_fd, LOCK_UN); return; }
+    if (!found)
+    {
+        sl->hash = hash;
+        sl->str_off = h->str_used;
+        sl->rank = 0;
+        memcpy(FREC_STRS(h) + h->str_used, path, plen);
+        h->str_used += (uint32_t)plen;
+        h->used++;
+    }
+    sl->rank += 1.0f;
+    sl->last = (int64_t)time(NULL);
+    h->total_rank += 1.0;
+    if (h->total_rank > FRECENCY_MAX_TOTAL) frecency_rebuild(0.9, 0);
+    flock(frec_fd, LOCK_UN);
+}
+
+/* Updates queued by the UI thread for the frecency writer, which also
+ * opens the file so startup does not wait on $HOME either. */
+#define FRECENCY_QUEUE_MAX 256
+
+typedef struct FrecencyNote {
+    struct FrecencyNote *next;
+    char path[];
+} FrecencyNote;
+
+static FrecencyNote *frec_queue;
+static FrecencyNote **frec_queue_tail = &frec_queue;
+static int frec_queue_len;
+static int frec_writer_running;
+static int frec_writer_stop;
+static pthread_t frec_writer;
+static pthread_mutex_t frec_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t frec_queue_cond = PTHREAD_COND_INITIALIZER;
+
+static void frecency_note(const char *path)
+{
+    if (!path || !path[0]) return;
+    size_t plen = strlen(path) + 1;
+    FrecencyNote *note = malloc(sizeof(*note) + plen);
+    if (!note) return;
+    note->next = NULL;
+    memcpy(note->path, path, plen);
+    pthread_mutex_lock(&frec_queue_lock);
+    if (frec_queue_len >= FRECENCY_QUEUE_MAX) 
+    {
+        pthread_mutex_unlock(&frec_queue_lock);
+        free(note);
+        return;
+    }
+    *frec_queue_tail = note;
+    frec_queue_tail = &note->next;
+    frec_queue_len++;
+    pthread_cond_signal(&frec_queue_cond);
+    pthread_mutex_unlock(&frec_queue_lock);
+}
+
+/* Takes everything queued. Call with frec_queue_lock held. */
+static FrecencyNote *frecency_take_queue(void)
+{
+    FrecencyNote *batch = frec_queue;
+    frec_queue = NULL;
+    frec_queue_tail = &frec_queue;
+    frec_queue_len = 0;
+    return batch;
+}
+
+/* Call with frec_lock held. */
+static void frecency_apply(FrecencyNote *batch)
+{
+    while (batch)
+    {
+        FrecencyNote *next = batch->next;
+        frecency_add(batch->path);
+        free(batch);
+        batch = next;
+    }
+}
+
+/* Applies everything queued. frec_lock is taken before the queue is
+ * emptied, so a reader that drains first never misses a batch in flight. */
+static void frecency_drain(void)
+{
+    pthread_mutex_lock(&frec_lock);
+    pthread_mutex_lock(&frec_queue_lock);
+    FrecencyNote *batch = frecency_take_queue();
+    pthread_mutex_unlock(&frec_queue_lock);
+    frecency_apply(batch);
+    pthread_mutex_unlock(&frec_lock);
+}
+
+static void *frecency_writer_thread(void *arg)
+{
+    (void)arg;
+    trace_thread("frecency");
+    pthread_mutex_lock(&frec_lock);
+    frecency_open();
+    pthread_mutex_unlock(&frec_lock);
+    for (;;)
+    {
+        pthread_mutex_lock(&frec_queue_lock);
+        while (!frec_queue && !frec_writer_stop) pthread_cond_wait(&frec_queue_cond, &frec_queue_lock);
+        int stop = !frec_queue;
+        pthread_mutex_unlock(&frec_queue_lock);
+        if (stop) break;
+        frecency_drain();
+    }
+    return NULL;
+}
+
+/* Writes out what is still queued; run at exit. */
+static void frecency_stop(void)
+{
+    if (!frec_writer_running) return;
+    pthread_mutex_lock(&frec_queue_lock);
+    frec_writer_stop = 1;
+    pthread_cond_signal(&frec_queue_cond);
+    pthread_mutex_unlock(&frec_queue_lock);
+    pthread_join(frec_writer, NULL);
+    frec_writer_running = 0;
+}
+
+static void frecency_start(void)
+{
+    if (pthread_create(&frec_writer, NULL, frecency_writer_thread, NULL) != 0) 
+    {
+        frecency_open();
+        return;
+    }
+    frec_writer_running = 1;
+    atexit(frecency_stop);
+}
+
+static double frecency_weight(const FrecencySlot *sl, time_t now)
+{
+    double age = difftime(now, (time_t)sl->last);
+    if (age < 3600) return sl->rank * 4.0;
+    if (age < 86400) return sl->rank * 2.0;
+    if (age < 604800) return sl->rank * 0.5;
+    return sl->rank * 0.25;
+}
+
+/* h comes from frecency_read_begin. */
+static double frecency_score(FrecencyHeader *h, const char *path)
+{
+    if (!h) return 0.0;
+    int found;
+    FrecencySlot *sl = frecency_find(h, path, frecency_hash(path), &found);
+    return found ? frecency_weight(sl, time(NULL)) : 0.0;
+}
+
+static inline char ascii_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+}
+
+/* Case-insensitive search for an already lowercased needle. */
+static const char *find_folded(const char *hay, const char *needle, size_t nlen)
+{
+    for (; *hay; ++hay)
+    {
+        if (ascii_lower(*hay) != needle[0]) continue;
+        size_t k = 1;
+        while (k < nlen && hay[k] && ascii_lower(hay[k]) == needle[k]) k++;
+        if (k == nlen) return hay;
+    }
+    return NULL;
+}
+
+/* z-style match: the lowercased terms appear in order and the last one is
+ * inside the final path component. */
+static int frecency_matches(const char *path, char **terms, const size_t *lens, int nterms)
+{
+    if (nterms == 0) return 1;
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    if (!find_folded(base, terms[nterms - 1], lens[nterms - 1])) return 0;
+    const char *p = path;
+    for (int i = 0; i < nterms; ++i)
+    {
+        const char *hit = find_folded(p, terms[i], lens[i]);
+        if (!hit) return 0;
+        p = hit + lens[i];
+    }
+    return 1;
+}
+
+typedef struct {
+    double score;
+    char *path;
+} FrecencyHit;
+
+static int cmp_frecency_hit(const void *a, const void *b)
+{
+    double sa = ((const FrecencyHit *)a)->score, sb = ((const FrecencyHit *)b)->score;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/* Returns matching entries ordered by score, with their paths copied out
+ * of the shared map; release them with frecency_hits_free. */
+static int frecency_query(char **terms, int nterms, FrecencyHit **hits)
+{
+    *hits = NULL;
+    /* z reads the file anyway; apply queued visits first so `cd x; z`
+     * sees x. */
+    frecency_drain();
+    FrecencyHeader *h = frecency_read_begin();
+    if (!h) 
+    {
+        frecency_read_end();
+        return 0;
+    }
+    time_t now = time(NULL);
+    char *folded[32];
+    size_t lens[32];
+    if (nterms > 32) nterms = 32;
+    for (int i = 0; i < nterms; ++i)
+    {
+        lens[i] = strlen(terms[i]);
+        folded[i] = strdup(terms[i]);
+        if (!folded[i]) { nterms = i; break; }
+        for (size_t k = 0; k < lens[i]; ++k) folded[i][k] = ascii_lower(folded[i][k]);
+    }
+    /* The string heap holds exactly the live paths, so walk it linearly and
+     * only hash the ones that match. */
+    FrecencyHit *out = malloc(sizeof(FrecencyHit) * (h->used + 1));
+    int n = 0;
+    const char *path;
+    for (uint32_t off = 0; out && n <= (int)h->used && (path = frecency_str(h, off)) != NULL; )
+    {
+        size_t plen = strlen(path);
+        if (frecency_matches(path, folded, lens, nterms))
+        {
+            int found;
+            FrecencySlot *sl = frecency_find(h, path, frecency_hash(path), &found);
+            if (found && (out[n].path = strdup(path)) != NULL)
+            {
+                out[n].score = frecency_weight(sl, now);
+                n++;
+            }
+        }
+        off += (uint32_t)plen + 1;
+    }
+    frecency_read_end();
+    for (int i = 0; i < nterms; ++i) free(folded[i]);
+    if (!out) return 0;
+    qsort(out, n, sizeof(FrecencyHit), cmp_frecency_hit);
+    *hits = out;
+    return n;
+}
+
+static void frecency_hits_free(FrecencyHit *hits, int n)
+{
+    for (int i = 0; i < n; ++i) free(hits[i].path);
+    free(hits);
+}
+
+/* Finds the best-ranked existing directory other than exclude. */
+static int frecency_jump_target(char **terms, int nterms, const char *exclude, char *out, size_t outsz)
+{
+    FrecencyHit *hits;
+    int n = frecency_query(terms, nterms, &hits);
+    int ok = -1;
+    for (int i = 0; i < n && ok != 0; ++i)
+    {
+        const char *path = hits[i].path;
+        struct stat st;
+        if (exclude && strcmp(path, exclude) == 0) continue;
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            snprintf(out, outsz, "%s", path);
+            ok = 0;
+        }
+    }
+    frecency_hits_free(hits, n);
+    return ok;
+}
+
+static void frecency_list_in_tab(Tab *t, char **terms, int nterms)
+{
+    FrecencyHit *hits;
+    int n = frecency_query(terms, nterms, &hits);
+    if (n == 0) push_line(t, "z: no matching directories");
+    for (int i = 0; i < n && i < 10; ++i)
+    {
+        char tmp[MAX_LINE_LEN + 32];
+        snprintf(tmp, sizeof(tmp), "%8.1f  %s", hits[i].score, hits[i].path);
+        push_line(t, tmp);
+    }
+    frecency_hits_free(hits, n);
+    scroll_to_cursor(t);
+}
+
+static char *common_prefix_array(char **arr, int n) 
+{
+    if (n <= 0) return strdup("");
+    char *prefix = strdup(arr[0]);
+    for (int i = 1; i < n; ++i) 
+    {
+        int j = 0;
+        while (prefix[j] && arr[i][j] && prefix[j] == arr[i][j]) j++;
+        prefix[j] = '\0';
+    }
+    return prefix;
+}
+
+/* Sorted, deduplicated table of the executables on $PATH plus our builtins.
+ * Built on a background thread and rebuilt when inotify reports a change
+ * in one of the PATH directories. */
+typedef struct {
+    char **names;
+    int count;
+} PathIndex;
+
+static const char *builtin_names[] = { "bg", "cd", "clear", "echo", "exit", "fg", "hash", "history", "jobs", "multiWatch", "mwstat", "z" };
+
+static PathIndex path_index = { NULL, 0 };
+static pthread_mutex_t path_index_lock = PTHREAD_MUTEX_INITIALIZER;
+static int path_index_building = 0;
+static int path_index_stale = 0;
+static int path_inotify_fd = -1;
+
+static int cmp_strptr(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void path_index_free(PathIndex *pi)
+{
+    for (int i = 0; i < pi->count; ++i) free(pi->names[i]);
+    free(pi->names);
+    pi->names = NULL;
+    pi->count = 0;
+}
+
+static int path_index_add(PathIndex *pi, int *cap, const char *name)
+{
+    if (pi->count >= *cap)
+    {
+        int ncap = *cap ? *cap * 2 : 1024;
+        char **n = realloc(pi->names, sizeof(char*) * ncap);
+        if (!n) return -1;
+        pi->names = n;
+        *cap = ncap;
+    }
+    pi->names[pi->count] = strdup(name);
+    if (!pi->names[pi->count]) return -1;
+    pi->count++;
+    return 0;
+}
+
+static void path_index_scan(PathIndex *pi)
+{
+    int cap = 0;
+    for (size_t i = 0; i < sizeof(builtin_names)/sizeof(builtin_names[0]); ++i)
+        path_index_add(pi, &cap, builtin_names[i]);
+
+    const char *env = getenv("PATH");
+    char *paths = strdup(env ? env : "/usr/local/bin:/usr/bin:/bin");
+    if (!paths) return;
+    char *save = NULL;
+    for (char *dir = strtok_r(paths, ":", &save); dir; dir = strtok_r(NULL, ":", &save))
+    {
+        uint64_t ts = trace_begin();
+        DIR *d = opendir(dir[0] ? dir : ".");
+        if (!d) continue;
+        struct dirent *ent;
+        int before = pi->count;
+        while ((ent = readdir(d)) != NULL)
+        {
+            if (ent->d_name[0] == '.') continue;
+            struct stat st;
+            if (fstatat(dirfd(d), ent->d_name, &st, 0) != 0) continue;
+            if (!S_ISREG(st.st_mode) || !(st.st_mode & 0111)) continue;
+            path_index_add(pi, &cap, ent->d_name);
+        }
+        closedir(d);
+        trace_end("opendir PATH", ts, "entries", pi->count - before, NULL, 0);
+    }
+    free(paths);
+
+    if (pi->count == 0) return;
+    qsort(pi->names, pi->count, sizeof(char*), cmp_strptr);
+    int out = 1;
+    for (int i = 1; i < pi->count; ++i)
+    {
+        if (strcmp(pi->names[i], pi->names[out-1]) == 0) free(pi->names[i]);
+        else pi->names[out++] = pi->names[i];
+    }
+    pi->count = out;
+}
+
+static void *path_index_build_thread(void *arg)
+{
+    (void)arg;
+    trace_thread("path index");
+    for (;;)
+    {
+        PathIndex fresh = { NULL, 0 };
+        path_index_scan(&fresh);
+
+        pthread_mutex_lock(&path_index_lock);
+        PathIndex old = path_index;
+        path_index = fresh;
+        int again = path_index_stale;
+        path_index_stale = 0;
+        if (!again) path_index_building = 0;
+        pthread_mutex_unlock(&path_index_lock);
+
+        path_index_free(&old);
+        if (!again) break;
+    }
+    return NULL;
+}
+
+static void path_index_rebuild_async(void)
+{
+    pthread_mutex_lock(&path_index_lock);
+    if (path_index_building)
+    {
+        path_index_stale = 1;
+        pthread_mutex_unlock(&path_index_lock);
+        return;
+    }
+    path_index_building = 1;
+    pthread_mutex_unlock(&path_index_lock);
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, path_index_build_thread, NULL) == 0)
+    {
+        pthread_detach(th);
+    }
+    else
+    {
+        pthread_mutex_lock(&path_index_lock);
+        path_index_building = 0;
+        pthread_mutex_unlock(&path_index_lock);
+    }
+}
+
+static void path_index_init(void)
+{
+    path_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (path_inotify_fd >= 0)
+    {
+        const char *env = getenv("PATH");
+        char *paths = strdup(env ? env : "/usr/local/bin:/usr/bin:/bin");
+        char *save = NULL;
+        if (paths)
+        {
+            for (char *dir = strtok_r(paths, ":", &save); dir; dir = strtok_r(NULL, ":", &save))
+            {
+                inotify_add_watch(path_inotify_fd, dir[0] ? dir : ".",
+                                  IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                  IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+            }
+            free(paths);
+        }
+    }
+    path_index_rebuild_async();
+}
+
+/* bash-style command hash: command name to the absolute path it last
+ * resolved to, so a launch is a single execve instead of one per PATH
+ * entry. Only the UI thread touches it. It is dropped wholesale when PATH
+ * changes or a PATH directory changes, and per entry when the cached path
+ * no longer execs. */
+#define CMD_HASH_BUCKETS 256
+
+typedef struct CmdHashEntry {
+    char *name;
+    char *path;
+    unsigned hits;
+    struct CmdHashEntry *next;
+} CmdHashEntry;
+
+static CmdHashEntry *cmd_hash[CMD_HASH_BUCKETS];
+static char *cmd_hash_path_env;
+
+static unsigned cmd_hash_index(const char *name)
+{
+    unsigned h = 2166136261u;
+    while (*name) h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h % CMD_HASH_BUCKETS;
+}
+
+static void command_hash_clear(void)
+{
+    for (int i = 0; i < CMD_HASH_BUCKETS; ++i) 
+    {
+        while (cmd_hash[i]) 
+        {
+            CmdHashEntry *e = cmd_hash[i];
+            cmd_hash[i] = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+        }
+    }
+}
+
+static void command_hash_forget(const char *name)
+{
+    CmdHashEntry **pp = &cmd_hash[cmd_hash_index(name)];
+    while (*pp) 
+    {
+        if (strcmp((*pp)->name, name) == 0) 
+        {
+            CmdHashEntry *e = *pp;
+            *pp = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            return;
+        }
+        pp = &(*pp)->next;
+    }
+}
+
+static void command_hash_check_env(void)
+{
+    const char *env = getenv("PATH");
+    if (!env) env = "";
+    if (!cmd_hash_path_env || strcmp(cmd_hash_path_env, env) != 0) 
+    {
+        command_hash_clear();
+        free(cmd_hash_path_env);
+        cmd_hash_path_env = strdup(env);
+    }
+}
+
+static int command_search_path(const char *name, char *out, size_t n)
+{
+    const char *path = getenv("PATH");
+    if (!path) path = "/usr/local/bin:/usr/bin:/bin";
+    while (*path) 
+    {
+        const char *end = strchr(path, ':');
+        size_t dlen = end ? (size_t)(end - path) : strlen(path);
+        struct stat st;
+        int len = dlen ? snprintf(out, n, "%.*s/%s", (int)dlen, path, name)
+                       : snprintf(out, n, "%s", name);
+        if (len < (int)n && stat(out, &st) == 0 && S_ISREG(st.st_mode) && access(out, X_OK) == 0)
+            return 0;
+        if (!end) break;
+        path = end + 1;
+    }
+    return -1;
+}
+
+/* Returns the path to exec for name, or NULL if it is not on PATH. Names
+ * with a slash are used as given. count says whether this is a real use
+ * that should show up in the hit column of `hash`. */
+static const char *command_hash_lookup(const char *name, int count)
+{
+    if (strchr(name, '/')) return name;
+    command_hash_check_env();
+    unsigned b = cmd_hash_index(name);
+    for (CmdHashEntry *e = cmd_hash[b]; e; e = e->next) 
+    {
+        if (strcmp(e->name, name) == 0) 
+        {
+            if (count) e->hits++;
+            return e->path;
+        }
+    }
+    char full[PATH_MAX];
+    if (command_search_path(name, full, sizeof(full)) < 0) return NULL;
+    CmdHashEntry *e = malloc(sizeof(*e));
+    if (!e) return NULL;
+    e->name = strdup(name);
+    e->path = strdup(full);
+    if (!e->name || !e->path) 
+    {
+        free(e->name);
+        free(e->path);
+        free(e);
+        return NULL;
+    }
+    e->hits = count ? 1 : 0;
+    e->next = cmd_hash[b];
+    cmd_hash[b] = e;
+    return e->path;
+}
+
+/* Drains pending inotify events; any change in a PATH directory schedules
+ * a rebuild. Called once per main loop iteration. */
+static void path_index_poll(void)
+{
+    if (path_inotify_fd < 0) return;
+    char evbuf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    while (read(path_inotify_fd, evbuf, sizeof(evbuf)) > 0) changed = 1;
+    if (changed) 
+    {
+        command_hash_clear();
+        path_index_rebuild_async();
+    }
+}
+
+static int strvec_push(char ***v, int *n, int *cap, char *s)
+{
+    if (!s) return -1;
+    if (*n >= *cap)
+    {
+        int ncap = *cap ? *cap * 2 : 64;
+        char **nv = realloc(*v, sizeof(char*) * ncap);
+        if (!nv) { free(s); return -1; }
+        *v = nv;
+        *cap = ncap;
+    }
+    (*v)[(*n)++] = s;
+    return 0;
+}
+
+/* Appends every indexed name starting with prefix to the vector. */
+static void path_index_lookup(const char *prefix, char ***out, int *n, int *cap)
+{
+    size_t plen = strlen(prefix);
+    pthread_mutex_lock(&path_index_lock);
+    int lo = 0, hi = path_index.count;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (strncmp(path_index.names[mid], prefix, plen) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    for (int i = lo; i < path_index.count; ++i)
+    {
+        if (strncmp(path_index.names[i], prefix, plen) != 0) break;
+        strvec_push(out, n, cap, strdup(path_index.names[i]));
+    }
+    pthread_mutex_unlock(&path_index_lock);
+}
+
+static int is_command_position(const char *line, int start)
+{
+    int i = start - 1;
+    while (i >= 0 && isspace((unsigned char)line[i])) i--;
+    if (i < 0 || line[i] == '|' || line[i] == ';') return 1;
+    /* &, && and a pipeline start a command; >& and <& are redirections. */
+    return line[i] == '&' && (i == 0 || (line[i-1] != '>' && line[i-1] != '<'));
+}
+
+/* A directory scan for completion. The worker thread appends matches in
+ * batches; the UI thread takes them from autocomplete_poll. Either side may
+ * drop its reference first, so the request is refcounted. */
+typedef struct CompleteReq {
+    pthread_mutex_t lock;
+    int refs;
+    atomic_int cancelled;
+    int done;
+    char **items;
+    int count;
+    int cap;
+    double *scores;
+    int nscores;
+    char dir[PATH_MAX];
+    char prefix[MAX_LINE_LEN];
+} CompleteReq;
+
+#define COMPLETE_BATCH 64
+
+static void complete_req_release(CompleteReq *r)
+{
+    pthread_mutex_lock(&r->lock);
+    int refs = --r->refs;
+    pthread_mutex_unlock(&r->lock);
+    if (refs > 0) return;
+    for (int i = 0; i < r->count; ++i) free(r->items[i]);
+    free(r->items);
+    free(r->scores);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+static void complete_req_push(CompleteReq *r, char **batch, int nb)
+{
+    pthread_mutex_lock(&r->lock);
+    for (int i = 0; i < nb; ++i) strvec_push(&r->items, &r->count, &r->cap, batch[i]);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/* Sorted directory listings shared by completion and the native ls,
+ * revalidated against the directory's mtime on every lookup. Entries are
+ * immutable once published and refcounted under dir_cache_lock, so the
+ * completion thread and the UI can both hold one. */
+#define DIR_CACHE_SLOTS 32
+
+typedef struct {
+    char *path;
+    struct timespec mtime;
+    char **names;
+    int count;
+    int refs;
+    uint64_t used;
+} DirListing;
+
+static DirListing *dir_cache[DIR_CACHE_SLOTS];
+static uint64_t dir_cache_clock;
+static pthread_mutex_t dir_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int cmp_strcoll(const void *a, const void *b)
+{
+    return strcoll(*(char * const *)a, *(char * const *)b);
+}
+
+static void dir_listing_free(DirListing *dl)
+{
+    for (int i = 0; i < dl->count; ++i) free(dl->names[i]);
+    free(dl->names);
+    free(dl->path);
+    free(dl);
+}
+
+static void dir_listing_release(DirListing *dl)
+{
+    if (!dl) return;
+    pthread_mutex_lock(&dir_cache_lock);
+    int refs = --dl->refs;
+    pthread_mutex_unlock(&dir_cache_lock);
+    if (refs == 0) dir_listing_free(dl);
+}
+
+/* Returns path's listing (including . and ..) with a reference held, or
+ * NULL with errno set. */
+static DirListing *dir_listing_get(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) < 0) return NULL;
+    if (!S_ISDIR(st.st_mode)) { errno = ENOTDIR; return NULL; }
+
+    pthread_mutex_lock(&dir_cache_lock);
+    int victim = 0;
+    for (int i = 0; i < DIR_CACHE_SLOTS; ++i) 
+    {
+        DirListing *c = dir_cache[i];
+        if (!c) 
+        {
+            if (dir_cache[victim]) victim = i;
+            continue;
+        }
+        if (strcmp(c->path, path) == 0) 
+        {
+            if (c->mtime.tv_sec == st.st_mtim.tv_sec && c->mtime.tv_nsec == st.st_mtim.tv_nsec) 
+            {
+                c->used = ++dir_cache_clock;
+                c->refs++;
+                pthread_mutex_unlock(&dir_cache_lock);
+                return c;
+            }
+            victim = i;
+            break;
+        }
+        if (dir_cache[victim] && c->used < dir_cache[victim]->used) victim = i;
+    }
+    pthread_mutex_unlock(&dir_cache_lock);
+
+    uint64_t ts = trace_begin();
+    DirListing *dl = calloc(1, sizeof(*dl));
+    DIR *d = dl ? opendir(path) : NULL;
+    if (!d) 
+    {
+        free(dl);
+        return NULL;
+    }
+    int cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) strvec_push(&dl->names, &dl->count, &cap, strdup(ent->d_name));
+    closedir(d);
+    qsort(dl->names, dl->count, sizeof(char*), cmp_strcoll);
+    trace_end("opendir", ts, "entries", dl->count, NULL, 0);
+    dl->path = strdup(path);
+    dl->mtime = st.st_mtim;
+    dl->refs = 2;
+    if (!dl->path) 
+    {
+        dir_listing_free(dl);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    DirListing *old;
+    pthread_mutex_lock(&dir_cache_lock);
+    dl->used = ++dir_cache_clock;
+    old = dir_cache[victim];
+    dir_cache[victim] = dl;
+    pthread_mutex_unlock(&dir_cache_lock);
+    dir_listing_release(old);
+    return dl;
+}
+
+static void *complete_scan_thread(void *arg)
+{
+    CompleteReq *r = arg;
+    /* A thread starts per request; only the first takes the name, so they
+     * do not fill the trace's thread table. */
+    static atomic_flag named = ATOMIC_FLAG_INIT;
+    if (!atomic_flag_test_and_set(&named)) trace_thread("completion");
+    uint64_t ts = trace_begin();
+    int matched = 0, listed = 0, nscores = 0;
+    double *scores = NULL;
+    DirListing *dl = dir_listing_get(r->dir);
+    if (dl)
+    {
+        size_t plen = strlen(r->prefix);
+        char *batch[COMPLETE_BATCH];
+        int nb = 0;
+        for (int i = 0; i < dl->count && !atomic_load(&r->cancelled); ++i)
+        {
+            const char *n = dl->names[i];
+            if (plen != 0 && strncmp(n, r->prefix, plen) != 0) continue;
+            listed++;
+            char *name = strdup(n);
+            if (!name) continue;
+            batch[nb++] = name;
+            matched++;
+            if (nb == COMPLETE_BATCH)
+            {
+                complete_req_push(r, batch, nb);
+                nb = 0;
+            }
+        }
+        complete_req_push(r, batch, nb);
+        /* Frecency scores for the candidates, in the order they were
+         * streamed, so the UI can rank them without touching the file. */
+        if (matched > 1 && listed == matched && !atomic_load(&r->cancelled) &&
+            (scores = malloc(sizeof(double) * matched)))
+        {
+            FrecencyHeader *h = frecency_read_begin();
+            for (int i = 0; i < dl->count && nscores < matched; ++i)
+            {
+                const char *n = dl->names[i];
+                char full[PATH_MAX];
+                if (plen != 0 && strncmp(n, r->prefix, plen) != 0) continue;
+                scores[nscores] = 0.0;
+                if (snprintf(full, sizeof(full), "%s/%s", r->dir, n) < (int)sizeof(full))
+                    scores[nscores] = frecency_score(h, full);
+                nscores++;
+            }
+            frecency_read_end();
+        }
+        dir_listing_release(dl);
+    }
+    trace_end("complete scan", ts, "matches", matched, NULL, 0);
+    pthread_mutex_lock(&r->lock);
+    r->scores = scores;
+    r->nscores = nscores;
+    r->done = 1;
+    pthread_mutex_unlock(&r->lock);
+    complete_req_release(r);
+    return NULL;
+}
+
+static void autocomplete_clear(Tab *t)
+{
+    for (int i = 0; i < t->autocomplete_count; ++i)
+    {
+        if (t->autocomplete_matches[i])
+        {
+            free(t->autocomplete_matches[i]);
+            t->autocomplete_matches[i] = NULL;
+        }
+    }
+    t->autocomplete_count = 0;
+    t->autocomplete_start = 0;
+    t->autocomplete_pos = 0;
+}
+
+/* Abandons an in-flight scan and whatever it has streamed in so far. */
+static void autocomplete_cancel(Tab *t)
+{
+    if (!t->autocomplete_req) return;
+    atomic_store(&t->autocomplete_req->cancelled, 1);
+    complete_req_release(t->autocomplete_req);
+    t->autocomplete_req = NULL;
+    autocomplete_clear(t);
+}
+
+static void autocomplete_record_choice(Tab *t, const char *choice)
+{
+    if (t->autocomplete_cmdpos || !choice) return;
+    char full[PATH_MAX];
+    if (snprintf(full, sizeof(full), "%s/%s", t->cwd, choice) < (int)sizeof(full))
+        frecency_note(full);
+}
+
+typedef struct {
+    double score;
+    int index;
+    char *name;
+} RankedMatch;
+
+static int cmp_ranked_match(const void *a, const void *b)
+{
+    const RankedMatch *x = a, *y = b;
+    if (x->score != y->score) return x->score < y->score ? 1 : -1;
+    return x->index - y->index;
+}
+
+/* Orders directory candidates by the frecency scores the scan thread
+ * computed; ties keep the listing's collation order. */
+static void autocomplete_rank(Tab *t, const double *scores, int nscores)
+{
+    int n = t->autocomplete_count;
+    if (!scores || nscores != n || n < 2) return;
+    RankedMatch *rm = malloc(sizeof(RankedMatch) * n);
+    if (!rm) return;
+    int any = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        rm[i].index = i;
+        rm[i].name = t->autocomplete_matches[i];
+        rm[i].score = scores[i];
+        if (rm[i].score > 0.0) any = 1;
+    }
+    if (any)
+    {
+        qsort(rm, n, sizeof(RankedMatch), cmp_ranked_match);
+        for (int i = 0; i < n; ++i) t->autocomplete_matches[i] = rm[i].name;
+    }
+    free(rm);
+}
+
+/* Applies a finished candidate set: a single match or a longer common
+ * prefix is inserted into the line, anything else is listed for 1-9/0. */
+static void autocomplete_finish(Tab *t)
+{
+    int start = t->autocomplete_start;
+    int pos = t->autocomplete_pos;
+    int pref_len = pos - start;
+
+    if (t->autocomplete_count == 0) return;
+
+    if (t->autocomplete_count == 1) {
+        autocomplete_record_choice(t, t->autocomplete_matches[0]);
+        int matchlen = (int)strlen(t->autocomplete_matches[0]);
+        int tail_len = t->current_len - pos;
+        if (start + matchlen + tail_len < MAX_LINE_LEN) 
+        {
+            memmove(&t->current_line[start + matchlen], &t->current_line[pos], tail_len + 1);
+            memcpy(&t->current_line[start], t->autocomplete_matches[0], matchlen);
+            t->current_len = start + matchlen + tail_len;
+            t->cursor_pos = start + matchlen;
+        }
+        free(t->autocomplete_matches[0]);
+        t->autocomplete_matches[0] = NULL;
+        t->autocomplete_count = 0;
+        scroll_to_cursor(t);
+        return;
+    }
+
+    char *pref = common_prefix_array(t->autocomplete_matches, t->autocomplete_count);
+    int pref_len2 = (int)strlen(pref);
+    if (pref_len2 > pref_len) 
+    {
+        int tail_len = t->current_len - pos;
+        if (start + pref_len2 + tail_len < MAX_LINE_LEN) 
+        {
+            memmove(&t->current_line[start + pref_len2], &t->current_line[pos], tail_len + 1);
+            memcpy(&t->current_line[start], pref, pref_len2);
+            t->current_len = start + pref_len2 + tail_len;
+            t->cursor_pos = start + pref_len2;
+        }
+        free(pref);
+        autocomplete_clear(t);
+        scroll_to_cursor(t);
+        return;
+    }
+    free(pref);
+
+    int shown = t->autocomplete_count;
+    if (shown > MAX_LINES - 2) shown = MAX_LINES - 2;
+    push_line(t, "Autocomplete options : ");
+    for (int i = 0; i < shown; ++i) 
+    {
+        char tmp[MAX_LINE_LEN + 32];
+        snprintf(tmp, sizeof(tmp), "%d. %s", i + 1, t->autocomplete_matches[i]);
+        push_line(t, tmp);
+    }
+    if (shown < t->autocomplete_count)
+    {
+        char tmp[64];
+        snprintf(tmp, sizeof(tmp), "... %d more", t->autocomplete_count - shown);
+        push_line(t, tmp);
+    }
+    scroll_to_cursor(t);
+}
+
+static void autocomplete_fill_gui(Tab *t, Display *display, Window win, GC gc, XFontStruct *font) 
+{
+    (void)win; (void)gc; (void)font;
+    autocomplete_cancel(t);
+
+    int pos = t->cursor_pos;
+    if (pos > t->current_len) pos = t->current_len;
+    int start = pos - 1;
+    while (start >= 0 && !isspace((unsigned char)t->current_line[start])) start--;
+    start++;
+    int pref_len = pos - start;
+    char prefix[MAX_LINE_LEN];
+    if (pref_len < 0) pref_len = 0;
+    memcpy(prefix, &t->current_line[start], pref_len);
+    prefix[pref_len] = '\0';
+
+    autocomplete_clear(t);
+    t->autocomplete_start = start;
+    t->autocomplete_pos = pos;
+    t->autocomplete_cmdpos = is_command_position(t->current_line, start) && pref_len > 0 && !strchr(prefix, '/');
+
+    if (t->autocomplete_cmdpos)
+    {
+        path_index_lookup(prefix, &t->autocomplete_matches, &t->autocomplete_count, &t->autocomplete_cap);
+        autocomplete_finish(t);
+        XFlush(display);
+        return;
+    }
+
+    CompleteReq *r = calloc(1, sizeof(*r));
+    if (!r) return;
+    pthread_mutex_init(&r->lock, NULL);
+    atomic_init(&r->cancelled, 0);
+    r->refs = 2;
+    snprintf(r->dir, sizeof(r->dir), "%s", t->cwd[0] ? t->cwd : ".");
+    memcpy(r->prefix, prefix, pref_len + 1);
+
+    pthread_t th;
+    if (pthread_create(&th, NULL, complete_scan_thread, r) != 0)
+    {
+        pthread_mutex_destroy(&r->lock);
+        free(r);
+        return;
+    }
+    pthread_detach(th);
+    t->autocomplete_req = r;
+}
+
+/* Moves newly streamed candidates into the tab and finishes the completion
+ * once the scan is done. Returns nonzero if anything changed. */
+static int autocomplete_poll(Tab *t)
+{
+    CompleteReq *r = t->autocomplete_req;
+    if (!r) return 0;
+
+    pthread_mutex_lock(&r->lock);
+    char **items = r->items;
+    int count = r->count;
+    int done = r->done;
+    double *scores = r->scores;
+    int nscores = r->nscores;
+    r->items = NULL;
+    r->count = r->cap = 0;
+    r->scores = NULL;
+    r->nscores = 0;
+    pthread_mutex_unlock(&r->lock);
+
+    for (int i = 0; i < count; ++i)
+        strvec_push(&t->autocomplete_matches, &t->autocomplete_count, &t->autocomplete_cap, items[i]);
+    free(items);
+
+    if (done)
+    {
+        complete_req_release(r);
+        t->autocomplete_req = NULL;
+        autocomplete_rank(t, scores, nscores);
+        autocomplete_finish(t);
+    }
+    free(scores);
+    return count > 0 || done;
+}
+
+void autocomplete_select(Tab *t, int key_digit) 
+{
+    if (key_digit < 1 || key_digit > t->autocomplete_count) return;
+    const char *choice = t->autocomplete_matches[key_digit - 1];
+    if (!choice) return;
+
+    int start = t->autocomplete_start;
+    int pos = t->autocomplete_pos;
+    int matchlen = (int)strlen(choice);
+    int tail_len = t->current_len - pos;
+    autocomplete_record_choice(t, choice);
+
+    if (start + matchlen + tail_len < MAX_LINE_LEN) 
+    {
+        memmove(&t->current_line[start + matchlen], &t->current_line[pos], tail_len + 1);
+        memcpy(&t->current_line[start], choice, matchlen);
+        t->current_len = start + matchlen + tail_len;
+        t->cursor_pos = start + matchlen;
+    }
+
+    for (int i = 0; i < t->autocomplete_count; ++i) 
+    {
+        free(t->autocomplete_matches[i]);
+        t->autocomplete_matches[i] = NULL;
+    }
+    t->autocomplete_count = 0;
+    scroll_to_cursor(t);
+}
+
+static uint64_t monotonic_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static int hist_index(uint64_t v)
+{
+    if (v < HIST_SUB) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    if (msb > HIST_MAX_MSB) return HIST_BUCKETS - 1;
+    int mag = msb - HIST_SUB_BITS + 1;
+    int sub = (int)(v >> mag);
+    return (mag + 1) * (HIST_SUB / 2) + sub - HIST_SUB / 2;
+}
+
+/* Smallest value that lands in bucket idx. */
+static uint64_t hist_value(int idx)
+{
+    if (idx < HIST_SUB) return (uint64_t)idx;
+    int mag = idx / (HIST_SUB / 2) - 1;
+    uint64_t sub = (uint64_t)(idx % (HIST_SUB / 2) + HIST_SUB / 2);
+    return sub << mag;
+}
+
+static void hist_record(LatencyHist *h, uint64_t v)
+{
+    h->counts[hist_index(v)]++;
+    if (h->total == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->total++;
+}
+
+/* Upper edge of the bucket holding the p-th percentile, capped at max. */
+static uint64_t hist_percentile(const LatencyHist *h, double p)
+{
+    if (h->total == 0) return 0;
+    uint64_t want = (uint64_t)(p / 100.0 * (double)h->total + 0.5);
+    if (want < 1) want = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) 
+    {
+        seen += h->counts[i];
+        if (seen >= want) 
+        {
+            uint64_t v = i + 1 < HIST_BUCKETS ? hist_value(i + 1) - 1 : h->max;
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+typedef struct {
+    int interval_ms;
+    int jitter_ms;
+    int max_running;
+    int diff;
+    int panes;
+    const char *log_path;
+} MWOptions;
+
+/* Reads the flags between "multiWatch" and the bracketed command list:
+ * -n SEC default interval, -j MS jitter, -c N concurrent runs, -o FILE log,
+ * -d only show lines that changed since the previous run, -p show each
+ * command in its own dashboard pane instead of the scrollback. */
+static int parse_multiwatch_options(char *argv[], int argc, MWOptions *o)
+{
+    o->interval_ms = MW_DEFAULT_INTERVAL_MS;
+    o->jitter_ms = 0;
+    o->max_running = MW_DEFAULT_MAX_RUNNING;
+    o->diff = 0;
+    o->panes = 0;
+    o->log_path = NULL;
+    for (int i = 1; i < argc && argv[i][0] != '['; ++i)
+    {
+        if (strcmp(argv[i], "-d") == 0) { o->diff = 1; continue; }
+        if (strcmp(argv[i], "-p") == 0) { o->panes = 1; continue; }
+        if (i + 1 >= argc) return -1;
+        if (strcmp(argv[i], "-n") == 0) o->interval_ms = (int)(atof(argv[++i]) * 1000);
+        else if (strcmp(argv[i], "-j") == 0) o->jitter_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0) o->max_running = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0) o->log_path = argv[++i];
+        else return -1;
+    }
+    if (o->interval_ms < 1 || o->jitter_ms < 0 || o->max_running < 1) return -1;
+    return 0;
+}
+
+/* Parses ["cmd", "@SEC cmd", ...]; an @SEC prefix overrides the interval.
+ * Returns the number of commands in a malloc'd array. */
+static int parse_multiwatch_args(char *input, MWCommand **out, int default_interval_ms) 
+{
+    *out = NULL;
+    char *lb=strchr(input,'[');
+    char *rb=strrchr(input,']');
+    if(!lb || !rb || rb<=lb) return 0;
+    char *p=lb+1;
+    int n=0, cap=0;
+    MWCommand *cmds=NULL;
+    while(p<rb)
+    {
+        while(p<rb && isspace((unsigned char)*p)) p++;
+        if(*p=='"'||*p=='\'')
+        {
+            char quote=*p++;
+            char tmp[1024]; int ti=0;
+            while(p<rb && *p!=quote && ti+1< (int)sizeof(tmp)) tmp[ti++]=*p++;
+            tmp[ti]='\0';
+            if(*p==quote)p++;
+
+            int interval=default_interval_ms;
+            char *body=tmp;
+            if(*body=='@')
+            {
+                char *endp;
+                double sec=strtod(body+1,&endp);
+                if(endp!=body+1 && sec>0) { interval=(int)(sec*1000); if(interval<1) interval=1; }
+                body=endp;
+                while(isspace((unsigned char)*body)) body++;
+            }
+            if(*body)
+            {
+                if(n>=cap)
+                {
+                    int ncap=cap?cap*2:16;
+                    MWCommand *nc=realloc(cmds,sizeof(MWCommand)*ncap);
+                    if(!nc) break;
+                    cmds=nc; cap=ncap;
+                }
+                memset(&cmds[n],0,sizeof(MWCommand));
+                cmds[n].cmd=strdup(body); cmds[n].pid=-1; cmds[n].fd=-1;
+                cmds[n].interval_ms=interval;
+                if(cmds[n].cmd) n++;
+            }
+        } 
+        else 
+        { 
+            while(p<rb && *p!=',') p++;
+            if(*p==',') p++; 
+        }
+        while(p<rb && (*p==',' || isspace((unsigned char)*p))) p++;
+    }
+    *out=cmds;
+    return n;
+}
+
+static MWRing *mw_ring_new(void)
+{
+    MWRing *r = calloc(1, sizeof(*r));
+    if (!r) return NULL;
+    r->buf = malloc(MW_RING_SIZE);
+    if (!r->buf) { free(r); return NULL; }
+    r->size = MW_RING_SIZE;
+    pthread_mutex_init(&r->lock, NULL);
+    return r;
+}
+
+static void mw_ring_free(MWRing *r)
+{
+    if (!r) return;
+    pthread_mutex_destroy(&r->lock);
+    free(r->buf);
+    free(r);
+}
+
+/* Returns the contiguous free region at head, clipped to *len. Anything
+ * the spill writer has not reached yet in that region is given up. */
+static char *mw_ring_reserve(MWRing *r, size_t *len)
+{
+    size_t off = (size_t)(r->head % r->size);
+    if (*len > r->size - off) *len = r->size - off;
+    pthread_mutex_lock(&r->lock);
+    if (r->head + *len - r->spilled > r->size)
+    {
+        uint64_t keep_from = r->head + *len - r->size;
+        r->dropped += keep_from - r->spilled;
+        r->spilled = keep_from;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return r->buf + off;
+}
+
+static void mw_ring_commit(MWRing *r, size_t n)
+{
+    pthread_mutex_lock(&r->lock);
+    r->head += n;
+    pthread_mutex_unlock(&r->lock);
+}
+
+/* Called by mw_launch: output from here on belongs to a new run. */
+static void mw_ring_mark_run(MWRing *r)
+{
+    pthread_mutex_lock(&r->lock);
+    if (r->runs - r->runs_spilled == MW_RUN_MARKS) r->runs_spilled++;
+    MWRunMark *m = &r->marks[r->runs % MW_RUN_MARKS];
+    m->at = r->head;
+    m->when = time(NULL);
+    r->runs++;
+    pthread_mutex_unlock(&r->lock);
+}
+
+/* Optional log of everything a multiWatch session prints, written by a
+ * background thread straight out of the commands' rings. Each run gets
+ * one "cmd" , time : header, before its first byte. */
+typedef struct MWSpill {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    int log_fd;
+    int n;
+    MWRing **rings;
+    char **cmds;
+} MWSpill;
+
+static void *mw_spill_thread(void *arg)
+{
+    MWSpill *sp = arg;
+    char *chunk = malloc(MW_RING_SIZE);
+    if (!chunk) return NULL;
+    for (;;)
+    {
+        pthread_mutex_lock(&sp->lock);
+        int stop = sp->stop;
+        pthread_mutex_unlock(&sp->lock);
+
+        int wrote = 0;
+        for (int i = 0; i < sp->n; ++i)
+        {
+            MWRing *r = sp->rings[i];
+            MWRunMark marks[MW_RUN_MARKS];
+            int nmarks = 0;
+            pthread_mutex_lock(&r->lock);
+            uint64_t base = r->spilled;
+            size_t avail = (size_t)(r->head - r->spilled);
+            size_t off = (size_t)(r->spilled % r->size);
+            size_t first = avail < r->size - off ? avail : r->size - off;
+            memcpy(chunk, r->buf + off, first);
+            memcpy(chunk + first, r->buf, avail - first);
+            r->spilled = r->head;
+            /* A run that has printed nothing yet keeps its mark for the
+             * next pass; one that never printed before the next launch
+             * gets no header, as before. */
+            for (; r->runs_spilled < r->runs; r->runs_spilled++)
+            {
+                MWRunMark *m = &r->marks[r->runs_spilled % MW_RUN_MARKS];
+                int last = r->runs_spilled + 1 == r->runs;
+                if (last && m->at >= r->head) break;
+                if (!last && r->marks[(r->runs_spilled + 1) % MW_RUN_MARKS].at == m->at) continue;
+                marks[nmarks++] = *m;
+            }
+            pthread_mutex_unlock(&r->lock);
+            if (avail == 0) continue;
+
+            size_t pos = 0;
+            ssize_t w;
+            for (int k = 0; k < nmarks; ++k)
+            {
+                size_t at = marks[k].at > base ? (size_t)(marks[k].at - base) : 0;
+                if (at > pos)
+                {
+                    w = write(sp->log_fd, chunk + pos, at - pos);
+                    pos = at;
+                }
+                char header[256];
+                struct tm tm_info;
+                char tstr[64];
+                localtime_r(&marks[k].when, &tm_info);
+                strftime(tstr, sizeof(tstr), "%Y-%m-%d %H:%M:%S", &tm_info);
+                int hl = snprintf(header, sizeof(header), "\"%s\" , %s :\n", sp->cmds[i], tstr);
+                if (hl > (int)sizeof(header) - 1) hl = (int)sizeof(header) - 1;
+                w = write(sp->log_fd, header, (size_t)hl);
+            }
+            w = write(sp->log_fd, chunk + pos, avail - pos);
+            (void)w;
+            wrote = 1;
+        }
+        if (stop) break;
+        if (!wrote)
+        {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 200000000;
+            if (until.tv_nsec >= 1000000000) { until.tv_sec++; until.tv_nsec -= 1000000000; }
+            pthread_mutex_lock(&sp->lock);
+            if (!sp->stop) pthread_cond_timedwait(&sp->cond, &sp->lock, &until);
+            pthread_mutex_unlock(&sp->lock);
+        }
+    }
+    free(chunk);
+    return NULL;
+}
+
+static MWSpill *mw_spill_start(MWSession *ms, int log_fd)
+{
+    MWSpill *sp = calloc(1, sizeof(*sp));
+    if (!sp) return NULL;
+    sp->n = ms->n;
+    sp->log_fd = log_fd;
+    sp->rings = calloc(sp->n, sizeof(MWRing*));
+    sp->cmds = calloc(sp->n, sizeof(char*));
+    if (!sp->rings || !sp->cmds) goto fail;
+    for (int i = 0; i < sp->n; ++i)
+    {
+        sp->rings[i] = ms->cmds[i].ring;
+        sp->cmds[i] = ms->cmds[i].cmd;
+    }
+    pthread_mutex_init(&sp->lock, NULL);
+    pthread_cond_init(&sp->cond, NULL);
+    if (pthread_create(&sp->thread, NULL, mw_spill_thread, sp) != 0)
+    {
+        pthread_mutex_destroy(&sp->lock);
+        pthread_cond_destroy(&sp->cond);
+        goto fail;
+    }
+    return sp;
+fail:
+    free(sp->rings);
+    free(sp->cmds);
+    free(sp);
+    return NULL;
+}
+
+static void mw_spill_kick(MWSpill *sp)
+{
+    if (!sp) return;
+    pthread_mutex_lock(&sp->lock);
+    pthread_cond_signal(&sp->cond);
+    pthread_mutex_unlock(&sp->lock);
+}
+
+/* Flushes what is left and closes the log. */
+static void mw_spill_stop(MWSpill *sp)
+{
+    if (!sp) return;
+    pthread_mutex_lock(&sp->lock);
+    sp->stop = 1;
+    pthread_cond_signal(&sp->cond);
+    pthread_mutex_unlock(&sp->lock);
+    pthread_join(sp->thread, NULL);
+    pthread_mutex_destroy(&sp->lock);
+    pthread_cond_destroy(&sp->cond);
+    close(sp->log_fd);
+    free(sp->rings);
+    free(sp->cmds);
+    free(sp);
+}
+
+/* Hashed timer wheel shared by every multiWatch session. Commands are
+ * bucketed by absolute due tick; a bucket may also hold commands due in a
+ * later revolution, which are left in place until their tick comes up. */
+#define MW_TICK_MS 20
+#define MW_WHEEL_SLOTS 512
+
+static MWCommand *mw_wheel[MW_WHEEL_SLOTS];
+static uint64_t mw_wheel_tick = 0;
+
+static void mw_wheel_remove(MWCommand *mc)
+{
+    if (!mc->in_wheel) return;
+    if (mc->wprev) mc->wprev->wnext = mc->wnext;
+    else mw_wheel[mc->due_tick % MW_WHEEL_SLOTS] = mc->wnext;
+    if (mc->wnext) mc->wnext->wprev = mc->wprev;
+    mc->wnext = mc->wprev = NULL;
+    mc->in_wheel = 0;
+}
+
+static void mw_wheel_insert(MWCommand *mc, uint64_t due_ms)
+{
+    mw_wheel_remove(mc);
+    uint64_t tick = due_ms / MW_TICK_MS;
+    if (tick <= mw_wheel_tick) tick = mw_wheel_tick + 1;
+    mc->due_tick = tick;
+    MWCommand **slot = &mw_wheel[tick % MW_WHEEL_SLOTS];
+    mc->wprev = NULL;
+    mc->wnext = *slot;
+    if (*slot) (*slot)->wprev = mc;
+    *slot = mc;
+    mc->in_wheel = 1;
+}
+
+static void mw_schedule_next(MWCommand *mc, uint64_t now_ms)
+{
+    int jitter = mc->session->jitter_ms;
+    uint64_t due = now_ms + (uint64_t)mc->interval_ms;
+    if (jitter > 0) due += (uint64_t)(rand() % (jitter + 1));
+    mw_wheel_insert(mc, due);
+}
+
+/* Bump allocator for everything a single command line needs. Chunks are
+ * chained and released together by arena_free; nothing is freed singly. */
+#define ARENA_CHUNK 4096
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t used;
+    size_t cap;
+    max_align_t data[];
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk *head;
+} Arena;
+
+static void *arena_alloc(Arena *a, size_t n)
+{
+    size_t align = sizeof(max_align_t);
+    n = (n + align - 1) & ~(align - 1);
+    ArenaChunk *c = a->head;
+    if (!c || c->cap - c->used < n) 
+    {
+        size_t cap = n > ARENA_CHUNK ? n : ARENA_CHUNK;
+        c = malloc(sizeof(ArenaChunk) + cap);
+        if (!c) return NULL;
+        c->next = a->head;
+        c->used = 0;
+        c->cap = cap;
+        a->head = c;
+    }
+    void *p = (char *)c->data + c->used;
+    c->used += n;
+    return p;
+}
+
+static char *arena_strdup(Arena *a, const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *d = arena_alloc(a, n);
+    if (d) memcpy(d, s, n);
+    return d;
+}
+
+static void arena_free(Arena *a)
+{
+    while (a->head) 
+    {
+        ArenaChunk *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+enum { REDIR_IN, REDIR_OUT, REDIR_APPEND, REDIR_ERR, REDIR_ERR_APPEND, REDIR_ERR_TO_OUT,
+       REDIR_TEE, REDIR_TEE_APPEND };
+
+typedef struct {
+    int kind;
+    const char *path;
+} Redir;
+
+/* Where a spawned stage reads and writes. The fds are wired up first and
+ * the redirections then applied in order, so "> f 2>&1" and "2>&1 > f"
+ * differ as they do in sh. pgid 0 starts a new process group. */
+typedef struct {
+    int in_fd;
+    int out_fd;
+    int err_fd;
+    const Redir *redirs;
+    int nredirs;
+    const char *cwd;
+    pid_t pgid;
+} SpawnSpec;
+
+static int spawn_add_redir(posix_spawn_file_actions_t *fa, const Redir *r)
+{
+    switch (r->kind) 
+    {
+        case REDIR_IN:
+            return posix_spawn_file_actions_addopen(fa, STDIN_FILENO, r->path, O_RDONLY, 0);
+        case REDIR_OUT:
+            return posix_spawn_file_actions_addopen(fa, STDOUT_FILENO, r->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        case REDIR_APPEND:
+            return posix_spawn_file_actions_addopen(fa, STDOUT_FILENO, r->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        case REDIR_ERR:
+            return posix_spawn_file_actions_addopen(fa, STDERR_FILENO, r->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        case REDIR_ERR_APPEND:
+            return posix_spawn_file_actions_addopen(fa, STDERR_FILENO, r->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        case REDIR_ERR_TO_OUT:
+            return posix_spawn_file_actions_adddup2(fa, STDOUT_FILENO, STDERR_FILENO);
+        case REDIR_TEE:
+        case REDIR_TEE_APPEND:
+            return 0;
+    }
+    return EINVAL;
+}
+
+/* Runs a file the kernel refused with ENOEXEC (a script with no #! line)
+ * under /bin/sh, as execvp does. */
+static int spawn_script(pid_t *pid_out, const char *path, const posix_spawn_file_actions_t *fa,
+                        const posix_spawnattr_t *attr, char *const argv[])
+{
+    int argc = 0;
+    while (argv[argc]) argc++;
+    char **sh_argv = malloc(sizeof(char *) * (argc + 2));
+    if (!sh_argv) return ENOMEM;
+    sh_argv[0] = "/bin/sh";
+    sh_argv[1] = (char *)path;
+    for (int i = 1; i <= argc; ++i) sh_argv[i + 1] = argv[i];
+    int err = posix_spawn(pid_out, "/bin/sh", fa, attr, sh_argv, environ);
+    free(sh_argv);
+    return err;
+}
+
+/* Launches one process with posix_spawn on the command's hashed path.
+ * glibc builds it on clone(CLONE_VM|CLONE_VFORK), so the parent's address
+ * space is never copied. Every fd the parent owns is expected to be O_CLOEXEC; only the
+ * three dup2 targets survive into the child. Returns 0 or an errno, which
+ * also covers exec and redirection failures. */
+static int spawn_stage(char *const argv[], const SpawnSpec *sp, pid_t *pid_out)
+{
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t none, defaults;
+    int err;
+
+    if ((err = posix_spawn_file_actions_init(&fa)) != 0) return err;
+    if ((err = posix_spawnattr_init(&attr)) != 0) 
+    {
+        posix_spawn_file_actions_destroy(&fa);
+        return err;
+    }
+
+    if (sp->cwd && sp->cwd[0]) err = posix_spawn_file_actions_addchdir_np(&fa, sp->cwd);
+    if (!err && sp->in_fd >= 0) err = posix_spawn_file_actions_adddup2(&fa, sp->in_fd, STDIN_FILENO);
+    if (!err && sp->out_fd >= 0) err = posix_spawn_file_actions_adddup2(&fa, sp->out_fd, STDOUT_FILENO);
+    if (!err && sp->err_fd >= 0) err = posix_spawn_file_actions_adddup2(&fa, sp->err_fd, STDERR_FILENO);
+    for (int i = 0; !err && i < sp->nredirs; ++i) err = spawn_add_redir(&fa, &sp->redirs[i]);
+
+    sigemptyset(&none);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGCHLD);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTIN);
+    sigaddset(&defaults, SIGTTOU);
+    if (!err) err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                                    POSIX_SPAWN_SETSIGDEF);
+    if (!err) err = posix_spawnattr_setpgroup(&attr, sp->pgid);
+    if (!err) err = posix_spawnattr_setsigmask(&attr, &none);
+    if (!err) err = posix_spawnattr_setsigdefault(&attr, &defaults);
+
+    if (!err) 
+    {
+        const char *path = command_hash_lookup(argv[0], 1);
+        err = path ? posix_spawn(pid_out, path, &fa, &attr, argv, environ) : ENOENT;
+        /* ENOENT and EACCES also come from a failed chdir or redirection;
+         * only a cached path that no longer execs means the entry is stale. */
+        if (path && path != argv[0] && (err == ENOENT || err == EACCES) && access(path, X_OK) != 0) 
+        {
+            command_hash_forget(argv[0]);
+            path = command_hash_lookup(argv[0], 0);
+            err = path ? posix_spawn(pid_out, path, &fa, &attr, argv, environ) : ENOENT;
+        }
+        if (path && err == ENOEXEC) err = spawn_script(pid_out, path, &fa, &attr, argv);
+    }
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&fa);
+    return err;
+}
+
+/* Starts one run of a watched command with stdout and stderr on a pipe. */
+static int mw_launch(MWCommand *mc)
+{
+    if (!mc->argv || !mc->argv[0]) return -1;
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) < 0) return -1;
+    static const Redir devnull = { REDIR_IN, "/dev/null" };
+    SpawnSpec sp = { -1, pfd[1], pfd[1], &devnull, 1, mc->session->cwd, 0 };
+    pid_t pid;
+    int err = spawn_stage(mc->argv, &sp, &pid);
+    close(pfd[1]);
+    if (err) 
+    {
+        close(pfd[0]);
+        mc->runs++;
+        mc->completed++;
+        mc->failed++;
+        mc->last_status = 127 << 8;
+        mc->spawn_errno = err;
+        return -1;
+    }
+    mc->spawn_errno = 0;
+    make_nonblocking(pfd[0]);
+    mc->fd = pfd[0];
+    mc->pid = pid;
+    mc->in_run = 0;
+    mc->runs++;
+    mw_ring_mark_run(mc->ring);
+    mc->run_start_us = monotonic_us();
+    mc->run_bytes = 0;
+    mc->run_reaped = 0;
+    mc->session->running++;
+    return 0;
+}
+
+/* Fires a due command: skipped if its previous run is still going, put
+ * off by a tick if the session is at its concurrency cap. */
+static void mw_fire(MWCommand *mc, uint64_t now_ms)
+{
+    MWSession *ms = mc->session;
+    if (mc->pid > 0 || mc->fd >= 0) 
+    {
+        mc->skipped++;
+        mw_schedule_next(mc, now_ms);
+        return;
+    }
+    if (ms->running >= ms->max_running) 
+    {
+        mw_wheel_insert(mc, now_ms + MW_TICK_MS);
+        return;
+    }
+    mw_launch(mc);
+    mw_schedule_next(mc, now_ms);
+}
+
+/* Processes every tick up to now. After a long stall only one revolution
+ * is walked; each bucket still fires everything that has come due. */
+static void mw_wheel_advance(uint64_t now_ms)
+{
+    uint64_t target = now_ms / MW_TICK_MS;
+    if (target <= mw_wheel_tick) return;
+    uint64_t from = mw_wheel_tick + 1;
+    if (target - from >= MW_WHEEL_SLOTS) from = target - MW_WHEEL_SLOTS + 1;
+    mw_wheel_tick = target;
+    for (uint64_t tick = from; tick <= target; ++tick) 
+    {
+        MWCommand *mc = mw_wheel[tick % MW_WHEEL_SLOTS];
+        while (mc) 
+        {
+            MWCommand *next = mc->wnext;
+            if (mc->due_tick <= target) 
+            {
+                mw_wheel_remove(mc);
+                mw_fire(mc, now_ms);
+            }
+            mc = next;
+        }
+    }
+}
+
+static int start_multiwatch_tab(Tab *tab, MWCommand *cmds, int n, const MWOptions *opt, int log_fd) 
+{
+    if (n <= 0) return 0;
+    if (tab->mw) return -1;
+
+    MWSession *ms = calloc(1, sizeof(*ms));
+    if (!ms) return -1;
+    ms->cmds = cmds;
+    ms->n = n;
+    ms->max_running = opt->max_running;
+    ms->jitter_ms = opt->jitter_ms;
+    ms->diff = opt->diff;
+    ms->panes = opt->panes;
+    snprintf(ms->cwd, sizeof(ms->cwd), "%s", tab->cwd);
+
+    for (int i = 0; i < n; ++i) 
+    {
+        cmds[i].session = ms;
+        cmds[i].ring = mw_ring_new();
+        cmds[i].partial = malloc(MAX_LINE_LEN);
+        size_t maxargs = strlen(cmds[i].cmd) / 2 + 2;
+        cmds[i].argv = malloc(sizeof(char*) * maxargs);
+        if (cmds[i].argv)
+            parse_command_line(cmds[i].cmd, cmds[i].argv, (int)maxargs, &cmds[i].argbuf);
+        if (!cmds[i].ring || !cmds[i].partial || !cmds[i].argv) 
+        {
+            for (int j = 0; j <= i; ++j) 
+            {
+                mw_ring_free(cmds[j].ring);
+                free(cmds[j].partial);
+                free(cmds[j].argv);
+                free(cmds[j].argbuf);
+                cmds[j].ring = NULL;
+                cmds[j].partial = NULL;
+                cmds[j].argv = NULL;
+                cmds[j].argbuf = NULL;
+            }
+            free(ms);
+            return -1;
+        }
+    }
+
+    uint64_t now = monotonic_ms();
+    if (mw_wheel_tick == 0) mw_wheel_tick = now / MW_TICK_MS - 1;
+    for (int i = 0; i < n; ++i) 
+    {
+        int jitter = ms->jitter_ms > 0 ? rand() % (ms->jitter_ms + 1) : 0;
+        mw_wheel_insert(&cmds[i], now + (uint64_t)jitter);
+    }
+
+    tab->mw = ms;
+    if (log_fd >= 0)
+    {
+        ms->spill = mw_spill_start(ms, log_fd);
+        if (!ms->spill) close(log_fd);
+    }
+    return n;
+}
+
+static void mw_pane_free(char **lines, int n)
+{
+    for (int i = 0; i < n; ++i) free(lines[i]);
+    free(lines);
+}
+
+/* Set when the window contents were lost and the dashboard must repaint
+ * every pane rather than only the dirty ones. Also set when a session is
+ * freed, since the next one may reuse its address. */
+static int dashboard_full_redraw = 1;
+
+static void stop_multiwatch_tab(Tab *tab) 
+{
+    MWSession *ms = tab->mw;
+    if (!ms) return;
+    for (int i = 0; i < ms->n; ++i) 
+    {
+        mw_wheel_remove(&ms->cmds[i]);
+        if (ms->cmds[i].pid > 0) kill(ms->cmds[i].pid, SIGTERM);
+    }
+    mw_spill_stop(ms->spill);
+    for (int i = 0; i < ms->n; ++i) 
+    {
+        MWCommand *mc = &ms->cmds[i];
+        if (mc->fd >= 0) close(mc->fd);
+        free(mc->cmd);
+        free(mc->partial);
+        free(mc->argv);
+        free(mc->argbuf);
+        free(mc->prev_hash);
+        free(mc->cur_hash);
+        mw_pane_free(mc->pane_lines, mc->pane_n);
+        mw_pane_free(mc->pane_next, mc->pane_next_n);
+        free(mc->hist);
+        mw_ring_free(mc->ring);
+    }
+    free(ms->cmds);
+    free(ms);
+    tab->mw = NULL;
+    dashboard_full_redraw = 1;
+}
+
+static uint64_t hash_line(const char *s)
+{
+    uint64_t h = 1469598103934665603ull;
+    while (*s) { h ^= (unsigned char)*s++; h *= 1099511628211ull; }
+    return h;
+}
+
+static void mw_run_begin(Tab *tt, MWCommand *mc)
+{
+    time_t now = time(NULL);
+    struct tm *tm_info = localtime(&now);
+    char tstr[64];
+    strftime(tstr, sizeof(tstr), "%Y-%m-%d %H:%M:%S", tm_info);
+    char header[256];
+    snprintf(header, sizeof(header), "\"%s\" , %s :", mc->cmd, tstr);
+    push_line(tt, header);
+    push_line(tt, "----------------------------------------------------");
+    mc->in_run = 1;
+}
+
+/* Handles one complete output line. In diff mode the line is compared by
+ * hash with the same line of the previous run and only shown if it differs. */
+static void mw_line(Tab *tt, MWCommand *mc, const char *line)
+{
+    if (mc->session->panes) 
+    {
+        if (mc->pane_next_n < MW_PANE_MAX_LINES)
+            strvec_push(&mc->pane_next, &mc->pane_next_n, &mc->pane_next_cap, strdup(line));
+        return;
+    }
+    if (!mc->session->diff) 
+    {
+        if (!mc->in_run) mw_run_begin(tt, mc);
+        push_line(tt, line);
+        return;
+    }
+
+    int idx = mc->cur_n;
+    uint64_t h = hash_line(line);
+    if (mc->cur_n >= mc->cur_cap) 
+    {
+        int ncap = mc->cur_cap ? mc->cur_cap * 2 : 64;
+        uint64_t *nh = realloc(mc->cur_hash, sizeof(uint64_t) * ncap);
+        if (!nh) return;
+        mc->cur_hash = nh;
+        mc->cur_cap = ncap;
+    }
+    mc->cur_hash[mc->cur_n++] = h;
+    if (idx < mc->prev_n && mc->prev_hash[idx] == h) return;
+
+    if (!mc->in_run) mw_run_begin(tt, mc);
+    char tmp[MAX_LINE_LEN + 16];
+    snprintf(tmp, sizeof(tmp), "%4d| %s", idx + 1, line);
+    push_line(tt, tmp);
+    mc->changed = 1;
+}
+
+/* Splits a run's output into lines using the command's own partial-line
+ * buffer, so concurrent runs do not interleave mid-line. */
+static void mw_emit(Tab *tt, MWCommand *mc, const char *data, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) 
+    {
+        char c = data[i];
+        if (c == '\r') continue;
+        if (c == '\n' || mc->partial_len >= MAX_LINE_LEN - 1) 
+        {
+            mc->partial[mc->partial_len] = '\0';
+            mw_line(tt, mc, mc->partial);
+            mc->partial_len = 0;
+            if (c == '\n') continue;
+        }
+        mc->partial[mc->partial_len++] = c;
+    }
+}
+
+/* Closes out a diff-mode run: reports dropped trailing lines, or collapses
+ * an unchanged run into a single marker that is updated in place. */
+static void mw_diff_finish(Tab *tt, MWCommand *mc)
+{
+    if (mc->cur_n < mc->prev_n) 
+    {
+        if (!mc->in_run) mw_run_begin(tt, mc);
+        char tmp[64];
+        snprintf(tmp, sizeof(tmp), "     (%d lines removed)", mc->prev_n - mc->cur_n);
+        push_line(tt, tmp);
+        mc->changed = 1;
+    }
+
+    if (!mc->changed && mc->runs > 1) 
+    {
+        time_t now = time(NULL);
+        struct tm *tm_info = localtime(&now);
+        char tstr[64];
+        strftime(tstr, sizeof(tstr), "%Y-%m-%d %H:%M:%S", tm_info);
+        char marker[256];
+        mc->unchanged_runs++;
+        snprintf(marker, sizeof(marker), "\"%s\" , %s : unchanged (x%lu)", mc->cmd, tstr, mc->unchanged_runs);
+        int found = -1;
+        int floor = tt->lines_count - 4 * mc->session->n - 4;
+        for (int i = tt->lines_count - 1; mc->unchanged_line && i >= 0 && i >= floor; --i) 
+        {
+            if (tt->lines[i] == mc->unchanged_line && strstr(tt->lines[i], " unchanged (x")) 
+            {
+                found = i;
+                break;
+            }
+        }
+        if (found >= 0) 
+        {
+            char *dup = strdup(marker);
+            if (dup) 
+            {
+                tt->scroll_bytes += line_bytes(dup) - line_bytes(tt->lines[found]);
+                free(tt->lines[found]);
+                tt->lines[found] = dup;
+                mc->unchanged_line = dup;
+            }
+        } 
+        else 
+        {
+            push_line(tt, marker);
+            mc->unchanged_line = tt->lines[tt->lines_count - 1];
+        }
+    } 
+    else if (mc->changed) 
+    {
+        mc->unchanged_line = NULL;
+        mc->unchanged_runs = 0;
+    }
+
+    uint64_t *tmp = mc->prev_hash;
+    int tmp_cap = mc->prev_cap;
+    mc->prev_hash = mc->cur_hash;
+    mc->prev_cap = mc->cur_cap;
+    mc->prev_n = mc->cur_n;
+    mc->cur_hash = tmp;
+    mc->cur_cap = tmp_cap;
+    mc->cur_n = 0;
+    mc->changed = 0;
+}
+
+/* Books a run once both its output has hit EOF and wait4 has reaped it. */
+static void mw_run_finalize(MWCommand *mc)
+{
+    uint64_t dur = monotonic_us() - mc->run_start_us;
+    if (!mc->hist) mc->hist = calloc(1, sizeof(LatencyHist));
+    if (mc->hist) hist_record(mc->hist, dur);
+    mc->completed++;
+    mc->last_status = mc->run_status;
+    if (!WIFEXITED(mc->run_status) || WEXITSTATUS(mc->run_status) != 0) mc->failed++;
+    mc->last_bytes = mc->run_bytes;
+    mc->total_bytes += mc->run_bytes;
+    mc->cpu_us += (uint64_t)(mc->run_usage.ru_utime.tv_sec + mc->run_usage.ru_stime.tv_sec) * 1000000 +
+                  (uint64_t)(mc->run_usage.ru_utime.tv_usec + mc->run_usage.ru_stime.tv_usec);
+    mc->run_reaped = 0;
+    mc->session->running--;
+}
+
+static void mw_run_end(Tab *tt, MWCommand *mc)
+{
+    if (mc->partial_len > 0) 
+    {
+        mc->partial[mc->partial_len] = '\0';
+        mw_line(tt, mc, mc->partial);
+        mc->partial_len = 0;
+    }
+    if (mc->session->panes) 
+    {
+        mw_pane_free(mc->pane_lines, mc->pane_n);
+        mc->pane_lines = mc->pane_next;
+        mc->pane_n = mc->pane_next_n;
+        mc->pane_next = NULL;
+        mc->pane_next_n = mc->pane_next_cap = 0;
+        mc->pane_time = time(NULL);
+        mc->pane_dirty = 1;
+    } 
+    else if (mc->session->diff) mw_diff_finish(tt, mc);
+    if (mc->in_run) push_line(tt, "----------------------------------------------------");
+    mc->in_run = 0;
+    close(mc->fd);
+    mc->fd = -1;
+    if (mc->run_reaped) mw_run_finalize(mc);
+}
+
+/* Routes an exited child to the multiWatch run it belongs to, if any. */
+static void mw_child_exited(Tab *tabs, int tab_count, pid_t pid, int status, const struct rusage *ru)
+{
+    for (int i = 0; i < tab_count; ++i) 
+    {
+        MWSession *ms = tabs[i].mw;
+        for (int m = 0; ms && m < ms->n; ++m) 
+        {
+            MWCommand *mc = &ms->cmds[m];
+            if (mc->pid != pid) continue;
+            mc->pid = -1;
+            mc->run_status = status;
+            mc->run_usage = *ru;
+            mc->run_reaped = 1;
+            if (mc->fd < 0) mw_run_finalize(mc);
+            return;
+        }
+    }
+}
+
+static void format_us(char *out, size_t n, uint64_t us)
+{
+    if (us < 1000) snprintf(out, n, "%lluus", (unsigned long long)us);
+    else if (us < 1000000) snprintf(out, n, "%.1fms", us / 1000.0);
+    else snprintf(out, n, "%.2fs", us / 1000000.0);
+}
+
+static void show_mwstat_in_tab(Tab *t)
+{
+    MWSession *ms = t->mw;
+    if (!ms) 
+    {
+        push_line(t, "mwstat: no multiWatch running in this tab");
+        scroll_to_cursor(t);
+        return;
+    }
+    for (int i = 0; i < ms->n; ++i) 
+    {
+        MWCommand *mc = &ms->cmds[i];
+        char p50[32], p90[32], p99[32], mx[32], cpu[32], last[32];
+        LatencyHist empty = { {0}, 0, 0, 0 };
+        const LatencyHist *h = mc->hist ? mc->hist : &empty;
+        format_us(p50, sizeof(p50), hist_percentile(h, 50));
+        format_us(p90, sizeof(p90), hist_percentile(h, 90));
+        format_us(p99, sizeof(p99), hist_percentile(h, 99));
+        format_us(mx, sizeof(mx), h->max);
+        format_us(cpu, sizeof(cpu), mc->completed ? mc->cpu_us / mc->completed : 0);
+        if (mc->completed == 0) snprintf(last, sizeof(last), "-");
+        else if (WIFEXITED(mc->last_status)) snprintf(last, sizeof(last), "exit %d", WEXITSTATUS(mc->last_status));
+        else if (WIFSIGNALED(mc->last_status)) snprintf(last, sizeof(last), "signal %d", WTERMSIG(mc->last_status));
+        else snprintf(last, sizeof(last), "?");
+
+        char line[MAX_LINE_LEN];
+        snprintf(line, sizeof(line), "\"%s\" every %.1fs", mc->cmd, mc->interval_ms / 1000.0);
+        push_line(t, line);
+        snprintf(line, sizeof(line),
+                 "  runs %lu  done %lu  failed %lu  skipped %lu  last %s  out %lluB (avg %lluB)",
+                 mc->runs, mc->completed, mc->failed, mc->skipped, last,
+                 (unsigned long long)mc->last_bytes,
+                 (unsigned long long)(mc->completed ? mc->total_bytes / mc->completed : 0));
+        push_line(t, line);
+        snprintf(line, sizeof(line), "  latency p50 %s  p90 %s  p99 %s  max %s  cpu/run %s",
+                 p50, p90, p99, mx, cpu);
+        push_line(t, line);
+        if (mc->spawn_errno) 
+        {
+            snprintf(line, sizeof(line), "  last launch failed: %s", strerror(mc->spawn_errno));
+            push_line(t, line);
+        }
+    }
+    scroll_to_cursor(t);
+}
+
+/* Reads one chunk from a run's pipe straight into the command's ring and
+ * appends it to the tab; the first chunk of a run gets the header. */
+static void mw_handle_readable(Tab *tt, MWCommand *mc)
+{
+    uint64_t ts = trace_begin();
+    size_t want = BUF_SIZE;
+    char *dst = mw_ring_reserve(mc->ring, &want);
+    ssize_t r = read(mc->fd, dst, want);
+    if (r > 0) 
+    {
+        mw_ring_commit(mc->ring, (size_t)r);
+        mc->run_bytes += (uint64_t)r;
+        perf_add(&tt->bytes_in, (uint64_t)r);
+        mw_spill_kick(mc->session->spill);
+        mw_emit(tt, mc, dst, (size_t)r);
+        trace_end("multiWatch chunk", ts, "bytes", r, "pid", mc->pid);
+    } 
+    else if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) 
+    {
+        mw_run_end(tt, mc);
+    }
+}
+
+/* A parsed command line: pipelines joined by ;, &&, || and &, each a run
+ * of stages. It all lives in the line's arena and is shared read-only by the
+ * parse cache and whichever tab is running it. */
+enum { LIST_SEQ, LIST_AND, LIST_OR };
+
+typedef struct {
+    char **argv;
+    unsigned char *glob;
+    int argc;
+    Redir *redirs;
+    int nredirs;
+    char *text;
+} Stage;
+
+typedef struct {
+    Stage *stages;
+    int n;
+    int op;
+    int background;
+    char *text;
+} Pipeline;
+
+typedef struct ParsedLine {
+    Arena arena;
+    int refs;
+    uint64_t hash;
+    uint64_t used;
+    char *key;
+    Pipeline *pipes;
+    int n;
+    char *error;
+} ParsedLine;
+
+enum { TOK_END, TOK_WORD, TOK_PIPE, TOK_AND, TOK_OR, TOK_SEMI, TOK_AMP, TOK_REDIR };
+
+typedef struct {
+    int kind;
+    int redir;
+    char *word;
+    int glob;
+    const char *start;
+    const char *end;
+} Token;
+
+static void *arena_grow(Arena *a, void *v, int n, int *cap, size_t elem)
+{
+    if (n < *cap) return v;
+    int ncap = *cap ? *cap * 2 : 8;
+    void *nv = arena_alloc(a, elem * ncap);
+    if (!nv) return NULL;
+    if (n) memcpy(nv, v, elem * n);
+    *cap = ncap;
+    return nv;
+}
+
+/* Reads the token at *pp. Words are unquoted and unescaped into *out,
+ * which has room for the rest of the line; operators only count outside
+ * quotes. Only unquoted * and ? mark a word for globbing. */
+static void next_token(const char **pp, char **out, Token *tk)
+{
+    const char *p = *pp;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || (*p == '\\' && p[1] == '\n'))
+        p += *p == '\\' ? 2 : 1;
+    tk->start = p;
+    tk->word = NULL;
+    tk->glob = 0;
+    tk->kind = TOK_REDIR;
+    if (!*p) tk->kind = TOK_END;
+    else if (p[0] == '|' && p[1] == '|') { tk->kind = TOK_OR; p += 2; }
+    else if (p[0] == '|') { tk->kind = TOK_PIPE; p++; }
+    else if (p[0] == '&' && p[1] == '&') { tk->kind = TOK_AND; p += 2; }
+    else if (p[0] == ';') { tk->kind = TOK_SEMI; p++; }
+    else if (p[0] == '&') { tk->kind = TOK_AMP; p++; }
+    else if (strncmp(p, "2>&1", 4) == 0) { tk->redir = REDIR_ERR_TO_OUT; p += 4; }
+    else if (strncmp(p, "2>>", 3) == 0) { tk->redir = REDIR_ERR_APPEND; p += 3; }
+    else if (strncmp(p, "2>", 2) == 0) { tk->redir = REDIR_ERR; p += 2; }
+    else if (strncmp(p, ">>+", 3) == 0) { tk->redir = REDIR_TEE_APPEND; p += 3; }
+    else if (strncmp(p, ">>", 2) == 0) { tk->redir = REDIR_APPEND; p += 2; }
+    else if (strncmp(p, ">+", 2) == 0) { tk->redir = REDIR_TEE; p += 2; }
+    else if (p[0] == '>') { tk->redir = REDIR_OUT; p++; }
+    else if (p[0] == '<') { tk->redir = REDIR_IN; p++; }
+    else 
+    {
+        char *w = *out;
+        tk->kind = TOK_WORD;
+        while (*p && !strchr(" \t\n|;<>&", *p)) 
+        {
+            if (*p == '"' || *p == '\'') 
+            {
+                char quote = *p++;
+                while (*p && *p != quote) 
+                {
+                    if (*p == '\\' && p[1]) 
+                    {
+                        p++;
+                        switch (*p) 
+                        {
+                            case 'n': *w++ = '\n'; break;
+                            case 't': *w++ = '\t'; break;
+                            case 'r': *w++ = '\r'; break;
+                            default: *w++ = *p; break;
+                        }
+                        p++;
+                    } 
+                    else 
+                    {
+                        *w++ = *p++;
+                    }
+                }
+                if (*p == quote) p++;
+            } 
+            else if (*p == '\\' && p[1]) 
+            {
+                if (p[1] != '\n') *w++ = p[1];
+                p += 2;
+            } 
+            else 
+            {
+                if (*p == '*' || *p == '?') tk->glob = 1;
+                *w++ = *p++;
+            }
+        }
+        *w++ = '\0';
+        tk->word = *out;
+        *out = w;
+    }
+    tk->end = p;
+    *pp = p;
+}
+
+static void parse_error(ParsedLine *pl, const Token *tk)
+{
+    char msg[128];
+    if (tk->kind == TOK_END)
+        snprintf(msg, sizeof(msg), "syntax error near unexpected token `newline'");
+    else
+        snprintf(msg, sizeof(msg), "syntax error near unexpected token `%.*s'",
+                 (int)(tk->end - tk->start), tk->start);
+    pl->error = arena_strdup(&pl->arena, msg);
+}
+
+/* Tokenizes and parses text in one pass. Returns NULL only when out of
+ * memory; syntax errors come back in pl->error. */
+static ParsedLine *parse_shell_line(const char *text)
+{
+    ParsedLine *pl = calloc(1, sizeof(*pl));
+    if (!pl) return NULL;
+    pl->refs = 1;
+    Arena *a = &pl->arena;
+    pl->key = arena_strdup(a, text);
+    char *out = arena_alloc(a, strlen(text) + 1);
+    if (!pl->key || !out) goto oom;
+
+    int pcap = 0, scap = 0, acap = 0, gcap = 0, rcap = 0;
+    Pipeline cur = { NULL, 0, LIST_SEQ, 0, NULL };
+    Stage st = { NULL, NULL, 0, NULL, 0, NULL };
+    const char *st_start = NULL, *st_end = NULL, *pipe_start = NULL;
+    const char *p = text;
+    Token tk;
+    for (;;) 
+    {
+        next_token(&p, &out, &tk);
+        if (tk.kind == TOK_WORD) 
+        {
+            st.argv = arena_grow(a, st.argv, st.argc, &acap, sizeof(char*));
+            st.glob = arena_grow(a, st.glob, st.argc, &gcap, 1);
+            if (!st.argv || !st.glob) goto oom;
+            st.glob[st.argc] = (unsigned char)tk.glob;
+            st.argv[st.argc++] = tk.word;
+            if (!st_start) st_start = tk.start;
+            st_end = tk.end;
+            continue;
+        }
+        if (tk.kind == TOK_REDIR) 
+        {
+            Token target;
+            if (!st_start) st_start = tk.start;
+            st_end = tk.end;
+            if (tk.redir != REDIR_ERR_TO_OUT) 
+            {
+                next_token(&p, &out, &target);
+                if (target.kind != TOK_WORD) { parse_error(pl, &target); return pl; }
+                st_end = target.end;
+            }
+            st.redirs = arena_grow(a, st.redirs, st.nredirs, &rcap, sizeof(Redir));
+            if (!st.redirs) goto oom;
+            st.redirs[st.nredirs].kind = tk.redir;
+            st.redirs[st.nredirs].path = tk.redir == REDIR_ERR_TO_OUT ? NULL : target.word;
+            st.nredirs++;
+            continue;
+        }
+
+        if (st.argc == 0) 
+        {
+            if (st.nredirs > 0 || tk.kind == TOK_PIPE || tk.kind == TOK_AND || tk.kind == TOK_OR ||
+                tk.kind == TOK_AMP || cur.n > 0 || cur.op != LIST_SEQ) 
+            {
+                parse_error(pl, &tk);
+                return pl;
+            }
+        } 
+        else 
+        {
+            st.argv = arena_grow(a, st.argv, st.argc, &acap, sizeof(char*));
+            if (!st.argv) goto oom;
+            st.argv[st.argc] = NULL;
+            size_t tlen = (size_t)(st_end - st_start);
+            st.text = arena_alloc(a, tlen + 1);
+            cur.stages = arena_grow(a, cur.stages, cur.n, &scap, sizeof(Stage));
+            if (!st.text || !cur.stages) goto oom;
+            memcpy(st.text, st_start, tlen);
+            st.text[tlen] = '\0';
+            if (cur.n == 0) pipe_start = st_start;
+            cur.stages[cur.n++] = st;
+            memset(&st, 0, sizeof(st));
+            acap = gcap = rcap = 0;
+            st_start = st_end = NULL;
+        }
+        if (tk.kind == TOK_PIPE) continue;
+
+        if (cur.n > 0) 
+        {
+            size_t tlen = (size_t)(tk.start - pipe_start);
+            while (tlen > 0 && strchr(" \t\n", pipe_start[tlen-1])) tlen--;
+            cur.text = arena_alloc(a, tlen + 1);
+            pl->pipes = arena_grow(a, pl->pipes, pl->n, &pcap, sizeof(Pipeline));
+            if (!cur.text || !pl->pipes) goto oom;
+            memcpy(cur.text, pipe_start, tlen);
+            cur.text[tlen] = '\0';
+            cur.background = tk.kind == TOK_AMP;
+            pl->pipes[pl->n++] = cur;
+            cur.stages = NULL;
+            cur.n = 0;
+            scap = 0;
+        }
+        if (tk.kind == TOK_END) break;
+        cur.op = tk.kind == TOK_AND ? LIST_AND : tk.kind == TOK_OR ? LIST_OR : LIST_SEQ;
+    }
+    return pl;
+
+oom:
+    arena_free(a);
+    free(pl);
+    return NULL;
+}
+
+/* Recently run lines are kept parsed; a history re-run skips the lexer. */
+#define PARSE_CACHE_SLOTS 64
+
+static ParsedLine *parse_cache[PARSE_CACHE_SLOTS];
+static uint64_t parse_cache_clock;
+
+static void parsed_line_release(ParsedLine *pl)
+{
+    if (pl && --pl->refs == 0) 
+    {
+        arena_free(&pl->arena);
+        free(pl);
+    }
+}
+
+/* Returns the parse of text with a reference the caller must release. */
+static ParsedLine *parse_line_cached(const char *text)
+{
+    uint64_t h = hash_line(text);
+    int victim = 0;
+    for (int i = 0; i < PARSE_CACHE_SLOTS; ++i) 
+    {
+        ParsedLine *c = parse_cache[i];
+        if (!c) 
+        {
+            if (parse_cache[victim]) victim = i;
+            continue;
+        }
+        if (c->hash == h && strcmp(c->key, text) == 0) 
+        {
+            c->used = ++parse_cache_clock;
+            c->refs++;
+            return c;
+        }
+        if (parse_cache[victim] && c->used < parse_cache[victim]->used) victim = i;
+    }
+    ParsedLine *pl = parse_shell_line(text);
+    if (!pl) return NULL;
+    pl->hash = h;
+    pl->used = ++parse_cache_clock;
+    parsed_line_release(parse_cache[victim]);
+    parse_cache[victim] = pl;
+    pl->refs++;
+    return pl;
+}
+
+/* Optional threaded output (--io-threads N). Each attached job's output
+ * pipe belongs to one worker, which reads it from its own epoll set,
+ * splits it into lines and hands batches to the UI thread over a
+ * single-producer/single-consumer ring, waking it through io_event_fd.
+ * The UI only pushes finished lines into scrollback. When a ring is full
+ * its worker stops reading until the UI frees a slot, so the pipes fill
+ * up behind it and the writers block. */
+#define IO_MAX_WORKERS 16
+#define IO_RING_SLOTS 256
+#define IO_READ_CHUNK (64 * 1024)
+#define IO_DRAIN_BUDGET (256 * 1024)
+
+/* One job's output as seen by its worker. job is only touched by the UI
+ * thread: it is cleared when the job goes away first, and the stream is
+ * freed by the UI once its EOF batch arrives. */
+typedef struct IoStream {
+    int fd;
+    struct IoWorker *worker;
+    Job *job;
+    char line[MAX_LINE_LEN];
+    int len;
+} IoStream;
+
+/* nlines lines packed NUL-separated into text; eof comes last. */
+typedef struct {
+    IoStream *stream;
+    char *text;
+    int nlines;
+    size_t bytes;
+    int eof;
+} IoBatch;
+
+typedef struct IoWorker {
+    int epfd;
+    int space_fd;
+    atomic_int want_space;
+    pthread_t thread;
+    IoBatch slots[IO_RING_SLOTS];
+    atomic_size_t head;
+    atomic_size_t tail;
+} IoWorker;
+
+static IoWorker *io_workers[IO_MAX_WORKERS];
+static int io_worker_count = 0;
+static int io_next_worker = 0;
+static int io_event_fd = -1;
+
+static int io_ring_push(IoWorker *w, const IoBatch *b)
+{
+    size_t tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&w->head, memory_order_acquire) == IO_RING_SLOTS) return 0;
+    w->slots[tail % IO_RING_SLOTS] = *b;
+    atomic_store_explicit(&w->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static int io_ring_pop(IoWorker *w, IoBatch *b)
+{
+    size_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&w->tail, memory_order_acquire)) return 0;
+    *b = w->slots[head % IO_RING_SLOTS];
+    atomic_store_explicit(&w->head, head + 1, memory_order_release);
+    return 1;
+}
+
+static int io_ring_full(IoWorker *w)
+{
+    return atomic_load(&w->tail) - atomic_load(&w->head) == IO_RING_SLOTS;
+}
+
+/* Only the worker pushes, and it reads nothing while the ring is full, so
+ * a batch always has a slot. */
+static void io_send(IoWorker *w, const IoBatch *b)
+{
+    io_ring_push(w, b);
+    uint64_t one = 1;
+    ssize_t n = write(io_event_fd, &one, sizeof(one));
+    (void)n;
+}
+
+/* Worker side: sleeps until the UI has taken a batch. want_space is set
+ * before the last look at the ring, and the UI clears it after popping,
+ * so a wakeup cannot be missed. */
+static void io_wait_space(IoWorker *w)
+{
+    atomic_store(&w->want_space, 1);
+    if (io_ring_full(w)) 
+    {
+        uint64_t count;
+        ssize_t n = read(w->space_fd, &count, sizeof(count));
+        (void)n;
+    }
+    atomic_store(&w->want_space, 0);
+}
+
+/* UI side, after popping from w. */
+static void io_notify_space(IoWorker *w)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_exchange(&w->want_space, 0)) return;
+    uint64_t one = 1;
+    ssize_t n = write(w->space_fd, &one, sizeof(one));
+    (void)n;
+}
+
+/* Reads one chunk of s and sends the lines it completes, the same way
+ * append_stream splits them; at EOF the partial line goes too. With the
+ * ring full the fd is left unread for this pass. */
+static void io_service(IoWorker *w, IoStream *s, char *buf)
+{
+    if (io_ring_full(w)) return;
+    ssize_t r = read(s->fd, buf, IO_READ_CHUNK);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    int eof = r <= 0;
+    if (r < 0) r = 0;
+
+    IoBatch b = { s, NULL, 0, (size_t)r, eof };
+    size_t cap = (size_t)s->len + 2 * (size_t)r + 2, used = 0;
+    b.text = malloc(cap);
+    if (!b.text) 
+    {
+        if (!eof) return;
+        s->len = 0;
+    }
+    for (ssize_t i = 0; b.text && i <= r; ++i) 
+    {
+        int end = i == r;
+        if (end && !(eof && s->len > 0)) break;
+        char c = end ? '\n' : buf[i];
+        if (c == '\r') continue;
+        if (c != '\n' && s->len < MAX_LINE_LEN - 1) 
+        {
+            s->line[s->len++] = c;
+            continue;
+        }
+        memcpy(b.text + used, s->line, (size_t)s->len);
+        used += (size_t)s->len;
+        b.text[used++] = '\0';
+        b.nlines++;
+        s->len = 0;
+        if (c != '\n') s->line[s->len++] = c;
+    }
+    if (b.nlines == 0 && !eof) 
+    {
+        free(b.text);
+        return;
+    }
+    if (eof) 
+    {
+        epoll_ctl(w->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+        close(s->fd);
+        s->fd = -1;
+    }
+    io_send(w, &b);
+}
+
+static void *io_worker_main(void *arg)
+{
+    IoWorker *w = arg;
+    char *buf = malloc(IO_READ_CHUNK);
+    struct epoll_event evs[32];
+    trace_thread("io worker");
+    while (buf) 
+    {
+        int n = epoll_wait(w->epfd, evs, 32, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; ++i) 
+        {
+            uint64_t ts = trace_begin();
+            io_service(w, evs[i].data.ptr, buf);
+            trace_end("io read", ts, NULL, 0, NULL, 0);
+        }
+        if (io_ring_full(w)) io_wait_space(w);
+    }
+    free(buf);
+    return NULL;
+}
+
+/* Starts n workers; with none, or if they cannot be started, output is
+ * read on the UI thread as before. */
+static void io_start(int n)
+{
+    if (n > IO_MAX_WORKERS) n = IO_MAX_WORKERS;
+    if (n <= 0) return;
+    io_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (io_event_fd < 0) return;
+    for (int i = 0; i < n; ++i) 
+    {
+        IoWorker *w = calloc(1, sizeof(*w));
+        if (!w) break;
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        w->space_fd = eventfd(0, EFD_CLOEXEC);
+        if (w->epfd < 0 || w->space_fd < 0 || pthread_create(&w->thread, NULL, io_worker_main, w) != 0) 
+        {
+            if (w->epfd >= 0) close(w->epfd);
+            if (w->space_fd >= 0) close(w->space_fd);
+            free(w);
+            break;
+        }
+        pthread_detach(w->thread);
+        io_workers[io_worker_count++] = w;
+    }
+}
+
+/* Hands j's output pipe to the next worker in turn. */
+static void io_attach(Job *j)
+{
+    if (io_worker_count == 0 || j->out_fd < 0) return;
+    IoStream *s = calloc(1, sizeof(*s));
+    if (!s) return;
+    s->fd = j->out_fd;
+    s->job = j;
+    s->worker = io_workers[io_next_worker++ % io_worker_count];
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = s;
+    j->io = s;
+    j->out_fd = -1;
+    if (epoll_ctl(s->worker->epfd, EPOLL_CTL_ADD, s->fd, &ev) < 0) 
+    {
+        j->out_fd = s->fd;
+        j->io = NULL;
+        free(s);
+    }
+}
+
+/* Adds a job for p to the tab's table, numbered one past the highest
+ * job still listed. */
+static Job *job_new(Tab *t, const Pipeline *p)
+{
+    if (t->njobs == t->jobs_cap) 
+    {
+        int ncap = t->jobs_cap ? t->jobs_cap * 2 : 4;
+        Job **nj = realloc(t->jobs, sizeof(Job*) * ncap);
+        if (!nj) return NULL;
+        t->jobs = nj;
+        t->jobs_cap = ncap;
+    }
+    Job *j = calloc(1, sizeof(*j));
+    if (!j) return NULL;
+    j->pids = calloc(p->n, sizeof(pid_t));
+    j->cmd = strdup(p->text ? p->text : "");
+    if (!j->pids || !j->cmd) 
+    {
+        free(j->pids);
+        free(j->cmd);
+        free(j);
+        return NULL;
+    }
+    j->id = 1;
+    for (int i = 0; i < t->njobs; ++i)
+        if (t->jobs[i]->id >= j->id) j->id = t->jobs[i]->id + 1;
+    j->last_pid = -1;
+    j->in_fd = j->out_fd = -1;
+    j->status = 127;
+    j->background = p->background;
+    t->jobs[t->njobs++] = j;
+    return j;
+}
+
+static void job_remove(Tab *t, Job *j)
+{
+    for (int i = 0; i < t->njobs; ++i) 
+    {
+        if (t->jobs[i] != j) continue;
+        memmove(&t->jobs[i], &t->jobs[i+1], sizeof(Job*) * (t->njobs - i - 1));
+        t->njobs--;
+        break;
+    }
+    if (t->fg == j) t->fg = NULL;
+    if (j->io) j->io->job = NULL;
+    if (j->in_fd >= 0) close(j->in_fd);
+    if (j->out_fd >= 0) close(j->out_fd);
+    free(j->pids);
+    free(j->cmd);
+    free(j);
+}
+
+static void init_tab(Tab *t, const char *inherit_cwd, int tab_number) 
+{
+    t->jobs = NULL;
+    t->njobs = t->jobs_cap = 0;
+    t->fg = NULL;
+    for (int j = 0; j < MAX_LINES; ++j) { t->lines[j] = NULL; t->is_command[j] = 0; }
+    t->lines_count = 0;
+    t->current_len = 0;
+    t->cursor_pos = 0;
+    t->current_line[0] = '\0';
+    t->stream_len = 0;
+    t->stream_line[0] = '\0';
+    t->mw = NULL;
+    t->scroll_offset = 0;
+    t->autocomplete_matches = NULL;
+    t->autocomplete_count = 0;
+    t->autocomplete_cap = 0;
+    t->autocomplete_req = NULL;
+    t->autocomplete_cmdpos = 0;
+    t->autocomplete_start = t->autocomplete_pos = 0;
+    t->run_line = NULL;
+    t->run_next = 0;
+    t->run_status = 0;
+    atomic_init(&t->bytes_in, 0);
+    atomic_init(&t->lines_in, 0);
+    if (inherit_cwd && inherit_cwd[0]) strncpy(t->cwd, inherit_cwd, sizeof(t->cwd)-1);
+    else if (getcwd(t->cwd, sizeof(t->cwd)) == NULL) t->cwd[0] = '\0';
+    char tab_info[64];
+    snprintf(tab_info, sizeof(tab_info), "Tab %d", tab_number);
+    t->lines[0] = strdup(tab_info);
+    t->is_command[0] = 0;
+    t->lines_count = 1;
+    t->scroll_bytes = line_bytes(t->lines[0]);
+}
+
+static void destroy_tab(Tab *t) 
+{
+    while (t->njobs > 0) 
+    {
+        Job *j = t->jobs[t->njobs - 1];
+        if (j->pgid > 0) kill(-j->pgid, SIGKILL);
+        for (int i = 0; i < j->npids; ++i)
+            if (j->pids[i] > 0) waitpid(j->pids[i], NULL, 0);
+        job_remove(t, j);
+    }
+    free(t->jobs);
+    t->jobs = NULL;
+    t->jobs_cap = 0;
+    stop_multiwatch_tab(t);
+    for (int i = 0; i < t->lines_count; ++i) 
+    {
+        if (t->lines[i]) free(t->lines[i]);
+    }
+    t->lines_count = 0;
+    t->scroll_bytes = 0;
+    autocomplete_cancel(t);
+    autocomplete_clear(t);
+    free(t->autocomplete_matches);
+    t->autocomplete_matches = NULL;
+    t->autocomplete_cap = 0;
+    parsed_line_release(t->run_line);
+    t->run_line = NULL;
+}
+
+/* Flat word list for one command line: stage argvs are NULL-terminated
+ * runs inside words, located by index once the list stops growing. */
+typedef struct {
+    Arena *arena;
+    char **words;
+    int n;
+    int cap;
+} ArgList;
+
+static int arglist_push(ArgList *l, char *w)
+{
+    if (l->n >= l->cap) 
+    {
+        int ncap = l->cap ? l->cap * 2 : 64;
+        char **nw = arena_alloc(l->arena, sizeof(char*) * ncap);
+        if (!nw) return -1;
+        if (l->n) memcpy(nw, l->words, sizeof(char*) * l->n);
+        l->words = nw;
+        l->cap = ncap;
+    }
+    l->words[l->n++] = w;
+    return 0;
+}
+
+/* cat and ls run natively unless MYTERM_NATIVE=0 or --no-native; any
+ * option they do not understand, and any redirection other than > and
+ * >>, falls back to the real binary. */
+enum { NATIVE_NONE, NATIVE_CAT, NATIVE_LS };
+
+#define NATIVE_INLINE_MAX (1 << 20)
+
+static int native_builtins = 1;
+
+static int native_kind(const Stage *st)
+{
+    if (!native_builtins) return NATIVE_NONE;
+    for (int r = 0; r < st->nredirs; ++r)
+        if (st->redirs[r].kind != REDIR_OUT && st->redirs[r].kind != REDIR_APPEND) return NATIVE_NONE;
+    if (strcmp(st->argv[0], "cat") == 0) 
+    {
+        if (st->argc < 2) return NATIVE_NONE;
+        for (int i = 1; i < st->argc; ++i)
+            if (st->argv[i][0] == '-') return NATIVE_NONE;
+        return NATIVE_CAT;
+    }
+    if (strcmp(st->argv[0], "ls") == 0) 
+    {
+        for (int i = 1; i < st->argc; ++i)
+            if (st->argv[i][0] == '-' && strspn(st->argv[i] + 1, "a1") != strlen(st->argv[i] + 1))
+                return NATIVE_NONE;
+        return NATIVE_LS;
+    }
+    return NATIVE_NONE;
+}
+
+/* Builtins that can feed a pipeline. Their output is rendered up front on
+ * the UI thread, so the helper thread never touches shared state. */
+static int is_stream_builtin(const Stage *st)
+{
+    return strcasecmp(st->argv[0], "echo") == 0 || strcmp(st->argv[0], "history") == 0 ||
+           native_kind(st) != NATIVE_NONE;
+}
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+static int outbuf_add(OutBuf *o, const char *s, size_t n)
+{
+    if (o->len + n > o->cap) 
+    {
+        size_t ncap = o->cap ? o->cap : 4096;
+        while (o->len + n > ncap) ncap *= 2;
+        char *nb = realloc(o->buf, ncap);
+        if (!nb) return -1;
+        o->buf = nb;
+        o->cap = ncap;
+    }
+    memcpy(o->buf + o->len, s, n);
+    o->len += n;
+    return 0;
+}
+
+static int resolve_in_cwd(const Tab *t, const char *path, char *out, size_t n)
+{
+    int len;
+    if (path[0] == '/' || !t->cwd[0]) len = snprintf(out, n, "%s", path);
+    else len = snprintf(out, n, "%s/%s", t->cwd, path);
+    if (len >= (int)n) { errno = ENAMETOOLONG; return -1; }
+    return 0;
+}
+
+static void native_ls_dir(OutBuf *o, const DirListing *dl, int all)
+{
+    for (int i = 0; i < dl->count; ++i) 
+    {
+        if (!all && dl->names[i][0] == '.') continue;
+        outbuf_add(o, dl->names[i], strlen(dl->names[i]));
+        outbuf_add(o, "\n", 1);
+    }
+}
+
+/* ls [-a1] [path...] as ls prints to a pipe: one name per line, operands
+ * that are files first, then each directory under a "dir:" header when
+ * more than one operand was given. Errors go to the tab. */
+static int native_ls(Tab *t, char **argv, OutBuf *o)
+{
+    int all = 0, nops = 0, status = 0;
+    for (int i = 1; argv[i]; ++i) 
+    {
+        if (argv[i][0] == '-' && argv[i][1]) { if (strchr(argv[i], 'a')) all = 1; }
+        else nops++;
+    }
+    if (nops == 0) 
+    {
+        DirListing *dl = dir_listing_get(t->cwd[0] ? t->cwd : ".");
+        if (!dl) return 2;
+        native_ls_dir(o, dl, all);
+        dir_listing_release(dl);
+        return 0;
+    }
+
+    char **dirs = calloc(nops, sizeof(char*));
+    char **files = calloc(nops, sizeof(char*));
+    int nd = 0, nf = 0;
+    if (!dirs || !files) { free(dirs); free(files); return 2; }
+    for (int i = 1; argv[i]; ++i) 
+    {
+        if (argv[i][0] == '-' && argv[i][1]) continue;
+        char path[PATH_MAX];
+        struct stat st;
+        if (resolve_in_cwd(t, argv[i], path, sizeof(path)) < 0 || stat(path, &st) < 0) 
+        {
+            char msg[PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "ls: cannot access '%s': %s", argv[i], strerror(errno));
+            push_line(t, msg);
+            status = 2;
+        } 
+        else if (S_ISDIR(st.st_mode)) dirs[nd++] = argv[i];
+        else files[nf++] = argv[i];
+    }
+    qsort(files, nf, sizeof(char*), cmp_strcoll);
+    qsort(dirs, nd, sizeof(char*), cmp_strcoll);
+    for (int i = 0; i < nf; ++i) 
+    {
+        outbuf_add(o, files[i], strlen(files[i]));
+        outbuf_add(o, "\n", 1);
+    }
+    for (int i = 0; i < nd; ++i) 
+    {
+        char path[PATH_MAX];
+        resolve_in_cwd(t, dirs[i], path, sizeof(path));
+        DirListing *dl = dir_listing_get(path);
+        if (!dl) 
+        {
+            char msg[PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "ls: cannot open directory '%s': %s", dirs[i], strerror(errno));
+            push_line(t, msg);
+            status = 2;
+            continue;
+        }
+        if (nf > 0 || i > 0) outbuf_add(o, "\n", 1);
+        if (nops > 1) 
+        {
+            outbuf_add(o, dirs[i], strlen(dirs[i]));
+            outbuf_add(o, ":\n", 2);
+        }
+        native_ls_dir(o, dl, all);
+        dir_listing_release(dl);
+    }
+    free(dirs);
+    free(files);
+    return status;
+}
+
+/* Opens cat's operands. Unreadable ones are reported in the tab and
+ * skipped; 1 is returned if there were any. *regular is cleared if an
+ * operand is not a regular file, since those (ttys, fifos, /dev/zero)
+ * are better left to a real cat that ^C can interrupt. */
+static int native_cat_open(Tab *t, char **argv, int *fds, int *nfds, off_t *total, int *regular)
+{
+    int status = 0;
+    *nfds = 0;
+    *total = 0;
+    *regular = 1;
+    for (int i = 1; argv[i]; ++i) 
+    {
+        char path[PATH_MAX];
+        struct stat st;
+        int fd = -1;
+        if (resolve_in_cwd(t, argv[i], path, sizeof(path)) == 0) fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0 && (fstat(fd, &st) < 0 || S_ISDIR(st.st_mode))) 
+        {
+            if (S_ISDIR(st.st_mode)) errno = EISDIR;
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0) 
+        {
+            char msg[PATH_MAX + 64];
+            snprintf(msg, sizeof(msg), "cat: %s: %s", argv[i], strerror(errno));
+            push_line(t, msg);
+            status = 1;
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) *regular = 0;
+        *total += st.st_size;
+        fds[(*nfds)++] = fd;
+    }
+    return status;
+}
+
+/* Sums the sizes of cat's operands; returns 0 if any that exists is not
+ * a regular file. */
+static int native_cat_regular(const Tab *t, char **argv, off_t *total)
+{
+    *total = 0;
+    for (int i = 1; argv[i]; ++i) 
+    {
+        char path[PATH_MAX];
+        struct stat st;
+        if (resolve_in_cwd(t, argv[i], path, sizeof(path)) < 0 || stat(path, &st) < 0) continue;
+        if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode)) return 0;
+        *total += st.st_size;
+    }
+    return 1;
+}
+
+static char *builtin_stage_output(const Stage *st, size_t *len)
+{
+    char *buf;
+    if (strcasecmp(st->argv[0], "echo") == 0) 
+    {
+        buf = malloc(MAX_LINE_LEN + 1);
+        if (!buf) return NULL;
+        const char *err = echo_render(st->text, buf, MAX_LINE_LEN);
+        if (err) snprintf(buf, MAX_LINE_LEN, "%s", err);
+        *len = strlen(buf);
+        buf[(*len)++] = '\n';
+        return buf;
+    }
+    OutBuf o = { NULL, 0, 0 };
+    int shown = 0;
+    for (int i = history_count - 1; i >= 0 && shown < HISTORY_SHOW; --i, ++shown) 
+    {
+        const char *h = history[i % HISTORY_MAX];
+        if (!h) continue;
+        if (outbuf_add(&o, h, strlen(h)) < 0 || outbuf_add(&o, "\n", 1) < 0) break;
+    }
+    if (!o.buf) o.buf = malloc(1);
+    *len = o.len;
+    return o.buf;
+}
+
+typedef struct {
+    int fd;
+    int hold_fd;
+    char *buf;
+    size_t len;
+    int *files;
+    int nfiles;
+} BuiltinOutput;
+
+static int write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0) 
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Copies an open file into out with sendfile, so the data never passes
+ * through user space; falls back to read/write where that is refused. */
+static int copy_file_to_fd(int in, int out)
+{
+    for (;;) 
+    {
+        ssize_t n = sendfile(out, in, NULL, 1 << 20);
+        if (n > 0) continue;
+        if (n == 0) return 0;
+        if (errno == EINTR) continue;
+        if (errno != EINVAL && errno != ENOSYS) return -1;
+        break;
+    }
+    char buf[65536];
+    ssize_t r;
+    while ((r = read(in, buf, sizeof(buf))) > 0)
+        if (write_all(out, buf, (size_t)r) < 0) return -1;
+    return r < 0 ? -1 : 0;
+}
+
+static void *builtin_output_thread(void *arg)
+{
+    BuiltinOutput *bo = arg;
+    int ok = bo->buf ? write_all(bo->fd, bo->buf, bo->len) == 0 : 1;
+    for (int i = 0; i < bo->nfiles; ++i) 
+    {
+        if (ok && copy_file_to_fd(bo->files[i], bo->fd) < 0) ok = 0;
+        close(bo->files[i]);
+    }
+    close(bo->fd);
+    if (bo->hold_fd >= 0) close(bo->hold_fd);
+    free(bo->files);
+    free(bo->buf);
+    free(bo);
+    return NULL;
+}
+
+/* Runs a stream builtin as a pipeline stage: no process, just a detached
+ * thread writing the rendered output (or, for cat, the files themselves)
+ * into out_fd or the file a >, >> redirection names, then closing it,
+ * which the next stage sees as EOF. When a redirection takes the output,
+ * out_fd is still held until the write is done, so the job does not end
+ * before the file is complete. argv is the glob-expanded word list.
+ * Returns 0 or an errno; *status gets the builtin's exit status. */
+static int run_builtin_stage(Tab *t, const Stage *st, char **argv, int out_fd, int *status)
+{
+    *status = 0;
+    int fd = fcntl(out_fd, F_DUPFD_CLOEXEC, 3);
+    if (fd < 0) return errno;
+    int hold_fd = -1;
+    for (int r = 0; r < st->nredirs; ++r) 
+    {
+        const Redir *rd = &st->redirs[r];
+        if (rd->kind != REDIR_OUT && rd->kind != REDIR_APPEND) continue;
+        char path[PATH_MAX];
+        if (resolve_in_cwd(t, rd->path, path, sizeof(path)) < 0) 
+        {
+            close(fd);
+            if (hold_fd >= 0) close(hold_fd);
+            return ENAMETOOLONG;
+        }
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (rd->kind == REDIR_APPEND ? O_APPEND : O_TRUNC);
+        int nfd = open(path, flags, 0644);
+        if (nfd < 0) 
+        {
+            int err = errno;
+            close(fd);
+            if (hold_fd >= 0) close(hold_fd);
+            return err;
+        }
+        if (hold_fd < 0) hold_fd = fd;
+        else close(fd);
+        fd = nfd;
+    }
+
+    BuiltinOutput *bo = calloc(1, sizeof(*bo));
+    if (!bo) 
+    {
+        close(fd);
+        if (hold_fd >= 0) close(hold_fd);
+        return ENOMEM;
+    }
+    bo->hold_fd = hold_fd;
+    int kind = native_kind(st);
+    if (kind == NATIVE_CAT) 
+    {
+        off_t total;
+        int regular, argc = 0;
+        while (argv[argc]) argc++;
+        bo->files = malloc(sizeof(int) * argc);
+        if (bo->files) *status = native_cat_open(t, argv, bo->files, &bo->nfiles, &total, &regular);
+    } 
+    else if (kind == NATIVE_LS) 
+    {
+        OutBuf o = { NULL, 0, 0 };
+        *status = native_ls(t, argv, &o);
+        bo->buf = o.buf;
+        bo->len = o.len;
+    } 
+    else 
+    {
+        bo->buf = builtin_stage_output(st, &bo->len);
+    }
+    if (kind == NATIVE_CAT ? !bo->files : kind != NATIVE_LS && !bo->buf) 
+    {
+        free(bo);
+        close(fd);
+        if (hold_fd >= 0) close(hold_fd);
+        return ENOMEM;
+    }
+    bo->fd = fd;
+    pthread_t th;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&th, &attr, builtin_output_thread, bo) != 0) builtin_output_thread(bo);
+    pthread_attr_destroy(&attr);
+    return 0;
+}
+
+#define TEE_CHUNK (1 << 16)
+
+/* A >+ or >>+ redirection. The stage writes into its own pipe, and a
+ * detached thread tee(2)s each chunk into the stage's normal output pipe
+ * before splice(2)ing the same bytes into the file, so the logged copy
+ * never passes through user space. If either side fails the other still
+ * gets everything. The thread owns all three fds. */
+typedef struct {
+    int in_fd;
+    int out_fd;
+    int file_fd;
+} TeeSpec;
+
+/* Moves up to n bytes from the tee pipe into fd, with read/write where
+ * splice is refused. Returns the bytes moved, 0 at EOF or -1. */
+static ssize_t tee_move(int in, int fd, size_t n)
+{
+    for (;;) 
+    {
+        ssize_t m = splice(in, NULL, fd, NULL, n, SPLICE_F_MOVE);
+        if (m >= 0) return m;
+        if (errno == EINTR) continue;
+        if (errno != EINVAL) return -1;
+        char buf[65536];
+        ssize_t r = read(in, buf, n < sizeof(buf) ? n : sizeof(buf));
+        if (r <= 0) return r;
+        return write_all(fd, buf, (size_t)r) == 0 ? r : -1;
+    }
+}
+
+static void *tee_thread(void *arg)
+{
+    TeeSpec *ts = arg;
+    for (;;) 
+    {
+        if (ts->out_fd >= 0 && ts->file_fd >= 0) 
+        {
+            ssize_t n = tee(ts->in_fd, ts->out_fd, TEE_CHUNK, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) 
+            {
+                close(ts->out_fd);
+                ts->out_fd = -1;
+                continue;
+            }
+            if (n == 0) break;
+            /* The teed bytes are still queued in the pipe; move exactly those. */
+            while (n > 0) 
+            {
+                ssize_t m = ts->file_fd >= 0 ? tee_move(ts->in_fd, ts->file_fd, (size_t)n) : -1;
+                if (m <= 0) 
+                {
+                    if (ts->file_fd >= 0) close(ts->file_fd);
+                    ts->file_fd = -1;
+                    char buf[4096];
+                    m = read(ts->in_fd, buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf));
+                    if (m <= 0) break;
+                }
+                n -= m;
+            }
+            continue;
+        }
+        int *fd = ts->out_fd >= 0 ? &ts->out_fd : &ts->file_fd;
+        if (*fd < 0) break;
+        ssize_t n = tee_move(ts->in_fd, *fd, TEE_CHUNK);
+        if (n == 0) break;
+        if (n < 0) 
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    close(ts->in_fd);
+    if (ts->out_fd >= 0) close(ts->out_fd);
+    if (ts->file_fd >= 0) close(ts->file_fd);
+    free(ts);
+    return NULL;
+}
+
+/* Starts the tee thread for st's last >+ / >>+ redirection, if it has one,
+ * and points *out_fd at the write end of the tee pipe, which the caller
+ * closes once the stage is started. Returns 0 or an errno. */
+static int start_tee(Tab *t, const Stage *st, int *out_fd)
+{
+    const Redir *rd = NULL;
+    for (int r = 0; r < st->nredirs; ++r)
+        if (st->redirs[r].kind == REDIR_TEE || st->redirs[r].kind == REDIR_TEE_APPEND) rd = &st->redirs[r];
+    if (!rd) return 0;
+
+    char path[PATH_MAX];
+    if (resolve_in_cwd(t, rd->path, path, sizeof(path)) < 0) return ENAMETOOLONG;
+    /* splice refuses O_APPEND files, so >>+ seeks to the end instead. */
+    int file_fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (rd->kind == REDIR_TEE ? O_TRUNC : 0), 0644);
+    if (file_fd < 0) return errno;
+    if (rd->kind == REDIR_TEE_APPEND) lseek(file_fd, 0, SEEK_END);
+
+    int p[2];
+    TeeSpec *ts = malloc(sizeof(*ts));
+    if (!ts || pipe2(p, O_CLOEXEC) < 0) 
+    {
+        int err = ts ? errno : ENOMEM;
+        free(ts);
+        close(file_fd);
+        return err;
+    }
+    ts->in_fd = p[0];
+    ts->out_fd = fcntl(*out_fd, F_DUPFD_CLOEXEC, 3);
+    ts->file_fd = file_fd;
+    int err = ts->out_fd < 0 ? errno : 0;
+    if (!err) 
+    {
+        pthread_t th;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        err = pthread_create(&th, &attr, tee_thread, ts);
+        pthread_attr_destroy(&attr);
+    }
+    if (err) 
+    {
+        close(p[0]);
+        close(p[1]);
+        if (ts->out_fd >= 0) close(ts->out_fd);
+        close(file_fd);
+        free(ts);
+        return err;
+    }
+    *out_fd = p[1];
+    return 0;
+}
+
+/* Appends st's words to list with globs expanded now, against the tab's
+ * directory rather than the GUI process's, then a NULL terminator. */
+static int expand_stage_argv(const Tab *t, Arena *a, ArgList *list, const Stage *st)
+{
+    size_t clen = strlen(t->cwd);
+    for (int w = 0; w < st->argc; w++) 
+    {
+        glob_t g;
+        char pattern[PATH_MAX];
+        int rel = st->argv[w][0] != '/' && clen > 0;
+        if (!st->glob[w] || resolve_in_cwd(t, st->argv[w], pattern, sizeof(pattern)) < 0 ||
+            glob(pattern, 0, NULL, &g) != 0) 
+        {
+            if (arglist_push(list, st->argv[w]) < 0) return -1;
+            continue;
+        }
+        for (size_t gi = 0; gi < g.gl_pathc; gi++) 
+        {
+            const char *m = g.gl_pathv[gi];
+            if (rel && strncmp(m, t->cwd, clen) == 0 && m[clen] == '/') m += clen + 1;
+            char *c = arena_strdup(a, m);
+            if (!c || arglist_push(list, c) < 0) { globfree(&g); return -1; }
+        }
+        globfree(&g);
+    }
+    return arglist_push(list, NULL);
+}
+
+/* Starts every stage of p as a new job in the tab, stdout of each
+ * feeding the next and the last one (and every stage's stderr) writing
+ * to the job's output pipe. Globs are expanded into an arena freed once
+ * all stages are spawned. Returns NULL if the pipes could not be set up. */
+static Job *spawn_pipeline_in_tab(Tab *t, const Pipeline *p)
+{
+    Arena arena = { NULL };
+    ArgList list = { &arena, NULL, 0, 0 };
+    int ncmds = p->n;
+
+    Job *job = job_new(t, p);
+    if (!job) 
+    {
+        perror("malloc");
+        return NULL;
+    }
+    /* Keystrokes reach a foreground job through a pipe. A background job,
+     * or any job in headless mode, reads /dev/null, as in a shell without
+     * job control, so it sees EOF instead of waiting on a pipe nobody
+     * writes. */
+    int inpipe[2] = {-1, -1};
+    int null_stdin = p->background || jobs_stdin_null;
+    if (null_stdin) inpipe[0] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (null_stdin ? inpipe[0] < 0 : pipe2(inpipe, O_CLOEXEC) < 0) 
+    {
+        perror(null_stdin ? "/dev/null" : "pipe");
+        job_remove(t, job);
+        return NULL;
+    }
+
+    char ***commands = arena_alloc(&arena, sizeof(char**) * ncmds);
+    int (*pipes)[2] = arena_alloc(&arena, sizeof(int[2]) * ncmds);
+    int *starts = arena_alloc(&arena, sizeof(int) * ncmds);
+    if (!commands || !pipes || !starts) goto oom;
+    for (int i = 0; i < ncmds; i++) 
+    {
+        starts[i] = list.n;
+        if (expand_stage_argv(t, &arena, &list, &p->stages[i]) < 0) goto oom;
+    }
+    for (int i = 0; i < ncmds; i++) commands[i] = &list.words[starts[i]];
+
+    int npipes = 0;
+    for (; npipes < ncmds-1; npipes++)
+        if (pipe2(pipes[npipes], O_CLOEXEC) < 0) 
+        {
+            perror("pipe"); goto close_pipes; 
+        }
+    int parent_pipe[2];
+    if (pipe2(parent_pipe, O_CLOEXEC) < 0) 
+    { 
+        perror("pipe"); goto close_pipes; 
+    }
+    pid_t pgid = 0;
+    for (int i = 0; i < ncmds; i++) 
+    {
+        const Stage *st = &p->stages[i];
+        SpawnSpec sp = { -1, -1, parent_pipe[1], st->redirs, st->nredirs, t->cwd, pgid };
+        sp.in_fd = i == 0 ? inpipe[0] : pipes[i-1][0];
+        sp.out_fd = i == ncmds-1 ? parent_pipe[1] : pipes[i][1];
+        int stage_out = sp.out_fd;
+        int tee_err = start_tee(t, st, &sp.out_fd);
+        if (tee_err) 
+        {
+            char msg[MAX_LINE_LEN];
+            snprintf(msg, sizeof(msg), "%s: %s", st->argv[0], strerror(tee_err));
+            push_line(t, msg);
+            scroll_to_cursor(t);
+            continue;
+        }
+
+        off_t total;
+        if (is_stream_builtin(st) && (native_kind(st) != NATIVE_CAT || native_cat_regular(t, commands[i], &total))) 
+        {
+            int status;
+            int err = run_builtin_stage(t, st, commands[i], sp.out_fd, &status);
+            if (sp.out_fd != stage_out) close(sp.out_fd);
+            if (err) 
+            {
+                char msg[MAX_LINE_LEN];
+                snprintf(msg, sizeof(msg), "%s: %s", st->argv[0], strerror(err));
+                push_line(t, msg);
+            } 
+            else if (i == ncmds-1) 
+            {
+                job->status = status;
+            }
+            scroll_to_cursor(t);
+            continue;
+        }
+
+        pid_t pid;
+        int err = spawn_stage(commands[i], &sp, &pid);
+        if (sp.out_fd != stage_out) close(sp.out_fd);
+        if (err) 
+        {
+            char msg[MAX_LINE_LEN];
+            snprintf(msg, sizeof(msg), "%s: %s", commands[i][0], strerror(err));
+            push_line(t, msg);
+            scroll_to_cursor(t);
+            continue;
+        }
+        if (pgid == 0) pgid = pid;
+        job->pgid = pgid;
+        job->pids[job->npids++] = pid;
+        job->nlive++;
+        if (i == ncmds-1) job->last_pid = pid;
+    }
+
+    for (int i = 0; i < npipes; i++) 
+    {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+
+    close(parent_pipe[1]);
+    job->out_fd = parent_pipe[0];
+    make_nonblocking(job->out_fd);
+
+    close(inpipe[0]);
+    job->in_fd = inpipe[1];
+    if (job->in_fd >= 0) make_nonblocking(job->in_fd);
+    io_attach(job);
+    arena_free(&arena);
+    return job;
+
+close_pipes:
+    for (int i = 0; i < npipes; i++) 
+    {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    goto fail;
+oom:
+    perror("malloc");
+fail:
+    close(inpipe[0]);
+    if (inpipe[1] >= 0) close(inpipe[1]);
+    arena_free(&arena);
+    job_remove(t, job);
+    return NULL;
+}
+
+
+/* Splits child output into the tab's lines. line/len is the partial
+ * line being assembled: the tab's own for inline output, or a job's. */
+static void append_stream(Tab *t, char *line, int *len, const char *s, int n) 
+{
+    if (n > 0) perf_add(&t->bytes_in, (uint64_t)n);
+    for (int i = 0; i < n; ++i) 
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\r') continue;
+
+        if (c == '\n') {
+            line[*len] = '\0';
+            push_line(t, line);
+            *len = 0;
+            line[0] = '\0';
+
+            scroll_to_cursor(t);
+        } 
+        else 
+        {
+            if (*len < MAX_LINE_LEN - 1) 
+            {
+                line[(*len)++] = (char)c;
+            } 
+            else 
+            {
+                line[*len] = '\0';
+                push_line(t, line);
+                *len = 0;
+                line[0] = '\0';
+            }
+        }
+    }
+}
+
+static void flush_stream(Tab *t, char *line, int *len)
+{
+    if (*len == 0) return;
+    line[*len] = '\0';
+    push_line(t, line);
+    *len = 0;
+    line[0] = '\0';
+}
+
+static void append_text(Tab *t, const char *s, int n) 
+{
+    append_stream(t, t->stream_line, &t->stream_len, s, n);
+}
+
+static int set_tab_cwd(Tab *t, const char *path) 
+{
+    if (!path) return -1;
+    char candidate[PATH_MAX];
+    if (path[0] == '/') 
+    {
+        strncpy(candidate, path, sizeof(candidate)-1);
+        candidate[sizeof(candidate)-1] = '\0';
+    } 
+    else 
+    {
+        if (t->cwd[0] == '\0') 
+        {
+            if (!getcwd(candidate, sizeof(candidate))) return -1;
+            strncat(candidate, "/", sizeof(candidate) - strlen(candidate) - 1);
+            strncat(candidate, path, sizeof(candidate) - strlen(candidate) - 1);
+        } 
+        else 
+        {
+            snprintf(candidate, sizeof(candidate), "%s/%s", t->cwd, path);
+        }
+    }
+    struct stat st;
+    if (stat(candidate, &st) == 0 && S_ISDIR(st.st_mode)) 
+    {
+        char realp[PATH_MAX];
+        if (realpath(candidate, realp)) 
+        {
+            strncpy(t->cwd, realp, sizeof(t->cwd)-1);
+            t->cwd[sizeof(t->cwd)-1] = '\0';
+        } 
+        else 
+        {
+            strncpy(t->cwd, candidate, sizeof(t->cwd)-1);
+            t->cwd[sizeof(t->cwd)-1] = '\0';
+        }
+        frecency_note(t->cwd);
+        return 0;
+    } 
+    else 
+    {
+        return -1;
+    }
+}
+
+/* Prompt, input or search line, tab label and cursor at the given baseline. */
+static int exit_requested = 0;
+
+/* hash [-r] [-d name] [name...]: with no arguments, lists the table with
+ * hit counts; -r empties it, -d drops one entry, names are looked up and
+ * remembered. */
+static int run_hash_builtin(Tab *t, char **argv, int argc)
+{
+    char line[PATH_MAX + 32];
+    int status = 0;
+    if (argc == 1) 
+    {
+        command_hash_check_env();
+        int shown = 0;
+        for (int b = 0; b < CMD_HASH_BUCKETS; ++b) 
+        {
+            for (CmdHashEntry *e = cmd_hash[b]; e; e = e->next) 
+            {
+                if (!shown++) push_line(t, "hits\tcommand");
+                snprintf(line, sizeof(line), "%4u\t%s", e->hits, e->path);
+                push_line(t, line);
+            }
+        }
+        if (!shown) push_line(t, "hash: hash table empty");
+        scroll_to_cursor(t);
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) 
+    {
+        if (strcmp(argv[i], "-r") == 0) 
+        {
+            command_hash_clear();
+        } 
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) 
+        {
+            command_hash_forget(argv[++i]);
+        } 
+        else if (!command_hash_lookup(argv[i], 0)) 
+        {
+            snprintf(line, sizeof(line), "hash: %s: not found", argv[i]);
+            push_line(t, line);
+            status = 1;
+        }
+    }
+    scroll_to_cursor(t);
+    return status;
+}
+
+static void set_tab_label(Tab *t, int tab_number)
+{
+    char tab_info[64];
+    snprintf(tab_info, sizeof(tab_info), "Tab %d", tab_number);
+    mw_forget_line(t, t->lines[0]);
+    t->scroll_bytes -= line_bytes(t->lines[0]);
+    free(t->lines[0]);
+    t->lines[0] = strdup(tab_info);
+    t->scroll_bytes += line_bytes(t->lines[0]);
+}
+
+/* cat and ls on their own: small outputs are fed straight into the
+ * scrollback, with no pipe and no trip through the read loop. Returns -1
+ * to have the stage spawned instead, as a builtin stage for large files
+ * or the real binary for devices and fifos. */
+static int run_native_inline(Tab *t, const Stage *st, int kind)
+{
+    Arena arena = { NULL };
+    ArgList list = { &arena, NULL, 0, 0 };
+    int status = -1;
+    if (expand_stage_argv(t, &arena, &list, st) < 0) goto out;
+    char **argv = list.words;
+    if (kind == NATIVE_LS) 
+    {
+        OutBuf o = { NULL, 0, 0 };
+        status = native_ls(t, argv, &o);
+        if (o.len) append_text(t, o.buf, (int)o.len);
+        free(o.buf);
+    } 
+    else 
+    {
+        off_t total;
+        if (!native_cat_regular(t, argv, &total) || total > NATIVE_INLINE_MAX) goto out;
+        int argc = 0;
+        while (argv[argc]) argc++;
+        int *fds = malloc(sizeof(int) * argc);
+        int nfds, regular;
+        if (!fds) goto out;
+        status = native_cat_open(t, argv, fds, &nfds, &total, &regular);
+        /* read(), not mmap: a file truncated under a mapping raises
+         * SIGBUS, which would take down every tab. */
+        char buf[65536];
+        for (int i = 0; i < nfds; ++i) 
+        {
+            ssize_t n;
+            while ((n = read(fds[i], buf, sizeof(buf))) > 0) append_text(t, buf, (int)n);
+            close(fds[i]);
+        }
+        free(fds);
+    }
+    flush_stream(t, t->stream_line, &t->stream_len);
+    scroll_to_cursor(t);
+out:
+    arena_free(&arena);
+    return status;
+}
+
+/* One jobs-style line for j: its number, state and command. Finished
+ * jobs show how they ended. */
+static void job_report(Tab *t, const Job *j, int finished, int with_usage)
+{
+    char state[32];
+    if (!finished) snprintf(state, sizeof(state), "%s", j->state == JOB_STOPPED ? "Stopped" : "Running");
+    else if (j->status == 0) snprintf(state, sizeof(state), "Done");
+    else if (j->status > 128) snprintf(state, sizeof(state), "%s", strsignal(j->status - 128));
+    else snprintf(state, sizeof(state), "Exit %d", j->status);
+
+    char msg[MAX_LINE_LEN];
+    if (with_usage) 
+    {
+        char cpu[32];
+        format_us(cpu, sizeof(cpu), j->cpu_us);
+        snprintf(msg, sizeof(msg), "[%d]  %-6d %-10s cpu %-8s rss %ldk  %s", j->id, (int)j->pgid,
+                 state, cpu, j->maxrss_kb, j->cmd);
+    } 
+    else 
+    {
+        snprintf(msg, sizeof(msg), "[%d]  %-10s %s%s", j->id, state, j->cmd,
+                 !finished && j->background && j->state == JOB_RUNNING ? " &" : "");
+    }
+    push_line(t, msg);
+    scroll_to_cursor(t);
+}
+
+/* %n or n picks a job by number; no argument picks the newest. */
+static Job *job_lookup(Tab *t, char **argv, int argc)
+{
+    char msg[MAX_LINE_LEN];
+    if (argc < 2) 
+    {
+        if (t->njobs > 0) return t->jobs[t->njobs - 1];
+        snprintf(msg, sizeof(msg), "%s: no current job", argv[0]);
+    } 
+    else 
+    {
+        const char *spec = argv[1][0] == '%' ? argv[1] + 1 : argv[1];
+        char *end;
+        long id = strtol(spec, &end, 10);
+        for (int i = 0; *spec && !*end && i < t->njobs; ++i)
+            if (t->jobs[i]->id == id) return t->jobs[i];
+        snprintf(msg, sizeof(msg), "%s: %s: no such job", argv[0], argv[1]);
+    }
+    push_line(t, msg);
+    scroll_to_cursor(t);
+    return NULL;
+}
+
+/* jobs [-l], fg [%n] and bg [%n]. fg makes the job the tab's foreground
+ * job, and the running list waits for it like any spawned pipeline. A job
+ * started with & keeps /dev/null as its stdin after fg. */
+static int run_job_builtin(Tab *t, char **argv, int argc)
+{
+    if (strcmp(argv[0], "jobs") == 0) 
+    {
+        int with_usage = argc > 1 && strcmp(argv[1], "-l") == 0;
+        for (int i = 0; i < t->njobs; ++i) job_report(t, t->jobs[i], 0, with_usage);
+        return 0;
+    }
+    Job *j = job_lookup(t, argv, argc);
+    if (!j) return 1;
+    if (strcmp(argv[0], "fg") == 0) 
+    {
+        push_line(t, j->cmd);
+        scroll_to_cursor(t);
+        j->background = 0;
+        t->fg = j;
+    } 
+    else 
+    {
+        j->background = 1;
+        char msg[MAX_LINE_LEN];
+        snprintf(msg, sizeof(msg), "[%d]  %s &", j->id, j->cmd);
+        push_line(t, msg);
+        scroll_to_cursor(t);
+    }
+    if (j->state == JOB_STOPPED) 
+    {
+        j->state = JOB_RUNNING;
+        if (j->pgid > 0) kill(-j->pgid, SIGCONT);
+    }
+    return 0;
+}
+
+/* Runs st in the GUI process if it names a builtin and returns its exit
+ * status, or -1 so the caller spawns it instead. */
+static int run_builtin(Tab *t, const Stage *st, int tab_number)
+{
+    char **argv = st->argv;
+    int argc = st->argc;
+    int native = native_kind(st);
+
+    if (native != NATIVE_NONE) return run_native_inline(t, st, native);
+
+    if (strcasecmp(argv[0], "echo") == 0) 
+    {
+        custom_echo_handler(t, st->text);
+        return 0;
+    }
+    if (strcasecmp(argv[0], "multiwatch") == 0) 
+    {
+        MWOptions mwopt;
+        MWCommand *mwcmds = NULL;
+        int mn = 0, status = 0;
+        if (parse_multiwatch_options(argv, argc, &mwopt) == 0)
+            mn = parse_multiwatch_args(st->text, &mwcmds, mwopt.interval_ms);
+        if (mn > 0 && !t->mw) {
+            int log_fd = -1;
+            if (mwopt.log_path) {
+                char logpath[PATH_MAX];
+                int plen;
+                if (mwopt.log_path[0] == '/')
+                    plen = snprintf(logpath, sizeof(logpath), "%s", mwopt.log_path);
+                else
+                    plen = snprintf(logpath, sizeof(logpath), "%s/%s", t->cwd, mwopt.log_path);
+                if (plen >= (int)sizeof(logpath)) errno = ENAMETOOLONG;
+                else log_fd = open(logpath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+                if (log_fd < 0) {
+                    char errbuf[PATH_MAX + 64];
+                    snprintf(errbuf, sizeof(errbuf), "multiWatch: %s: %s", logpath, strerror(errno));
+                    push_line(t, errbuf);
+                }
+            }
+            if (start_multiwatch_tab(t, mwcmds, mn, &mwopt, log_fd) <= 0) {
+                if (log_fd >= 0) close(log_fd);
+                push_line(t, "Failed to start multiWatch");
+                status = 1;
+            } else {
+                mwcmds = NULL;
+            }
+            scroll_to_cursor(t);
+        } else if (mn == 0) {
+            push_line(t, "Usage: multiWatch [-d] [-p] [-n sec] [-j ms] [-c max] [-o logfile] [\"cmd1\",\"@sec cmd2\",...]");
+            scroll_to_cursor(t);
+            status = 2;
+        }
+        if (mwcmds) {
+            for (int i = 0; i < mn; ++i) free(mwcmds[i].cmd);
+            free(mwcmds);
+        }
+        return status;
+    }
+    if (strcmp(argv[0], "mwstat") == 0) 
+    {
+        show_mwstat_in_tab(t);
+        return t->mw ? 0 : 1;
+    }
+    if (strcmp(argv[0], "cd") == 0) 
+    {
+        const char *dir = argc > 1 ? argv[1] : getenv("HOME");
+        if (!dir) return 1;
+        if (set_tab_cwd(t, dir) == 0) 
+        {
+            set_tab_label(t, tab_number);
+            if (argc > 1) push_line(t, "Directory changed");
+            scroll_to_cursor(t);
+            return 0;
+        }
+        if (argc > 1) 
+        {
+            char errbuf[256];
+            snprintf(errbuf, sizeof(errbuf), "cd: %s: %s", argv[1], strerror(errno));
+            push_line(t, errbuf);
+            scroll_to_cursor(t);
+        }
+        return 1;
+    }
+    if (strcmp(argv[0], "z") == 0) 
+    {
+        char target[PATH_MAX];
+        if (argc == 1) 
+        {
+            frecency_list_in_tab(t, NULL, 0);
+            return 0;
+        }
+        if (frecency_jump_target(&argv[1], argc - 1, t->cwd, target, sizeof(target)) == 0 &&
+            set_tab_cwd(t, target) == 0) 
+        {
+            push_line(t, t->cwd);
+            scroll_to_cursor(t);
+            return 0;
+        }
+        push_line(t, "z: no matching directory");
+        scroll_to_cursor(t);
+        return 1;
+    }
+    if (strcmp(argv[0], "clear") == 0) 
+    {
+        char tab_label[64];
+        snprintf(tab_label, sizeof(tab_label), "Tab %d", tab_number);
+        if (t->lines[0] == NULL || strcmp(t->lines[0], tab_label) != 0) {
+            mw_forget_line(t, t->lines[0]);
+            free(t->lines[0]);
+            t->lines[0] = strdup(tab_label);
+        }
+        t->is_command[0] = 0;
+        for (int i = 1; i < t->lines_count; i++) {
+            mw_forget_line(t, t->lines[i]);
+            free(t->lines[i]);
+            t->lines[i] = NULL;
+            t->is_command[i] = 0;
+        }
+        t->lines_count = 1;
+        t->scroll_bytes = line_bytes(t->lines[0]);
+        t->scroll_offset = 0;
+        return 0;
+    }
+    if (strcmp(argv[0], "exit") == 0) 
+    {
+        exit_requested = 1;
+        return 0;
+    }
+    if (strcmp(argv[0], "history") == 0) 
+    {
+        show_history_in_tab(t);
+        return 0;
+    }
+    if (strcmp(argv[0], "hash") == 0) 
+    {
+        return run_hash_builtin(t, argv, argc);
+    }
+    if (strcmp(argv[0], "jobs") == 0 || strcmp(argv[0], "fg") == 0 || strcmp(argv[0], "bg") == 0) 
+    {
+        return run_job_builtin(t, argv, argc);
+    }
+    return -1;
+}
+
+static void run_list_abort(Tab *t)
+{
+    parsed_line_release(t->run_line);
+    t->run_line = NULL;
+    t->run_next = 0;
+}
+
+/* Walks the tab's list from run_next. Builtins, skipped && / || branches
+ * and & pipelines run without waiting; the walk stops at the first
+ * foreground job and resumes from job_check once that job is finished. */
+static void run_list_continue(Tab *t, int tab_number)
+{
+    ParsedLine *pl = t->run_line;
+    while (pl && t->run_next < pl->n && !exit_requested) 
+    {
+        const Pipeline *p = &pl->pipes[t->run_next++];
+        if (p->op == LIST_AND && t->run_status != 0) continue;
+        if (p->op == LIST_OR && t->run_status == 0) continue;
+        if (p->n == 1 && !(p->stages[0].nredirs && is_stream_builtin(&p->stages[0]))) 
+        {
+            int status = run_builtin(t, &p->stages[0], tab_number);
+            if (status >= 0) 
+            {
+                t->run_status = status;
+                if (t->fg) return;
+                continue;
+            }
+        }
+        uint64_t ts = trace_begin();
+        Job *j = spawn_pipeline_in_tab(t, p);
+        trace_end("spawn", ts, "stages", p->n, NULL, 0);
+        if (!j) 
+        {
+            t->run_status = 127;
+            continue;
+        }
+        if (p->background) 
+        {
+            char msg[64];
+            if (j->pgid > 0) snprintf(msg, sizeof(msg), "[%d] %d", j->id, (int)j->pgid);
+            else snprintf(msg, sizeof(msg), "[%d]", j->id);
+            push_line(t, msg);
+            scroll_to_cursor(t);
+            t->run_status = 0;
+            continue;
+        }
+        t->fg = j;
+        return;
+    }
+    run_list_abort(t);
+}
+
+/* A job is finished once its output pipe is closed and every stage it
+ * spawned has been reaped. A foreground job hands its status on to the
+ * tab's list, and an interrupted one ends the list; a background job is
+ * just reported. */
+static void job_check(Tab *t, Job *j, int tab_number)
+{
+    if (j->out_fd >= 0 || j->io || j->nlive > 0) return;
+    if (j != t->fg) 
+    {
+        job_report(t, j, 1, 0);
+        job_remove(t, j);
+        return;
+    }
+    t->run_status = j->status;
+    job_remove(t, j);
+    if (!t->run_line) return;
+    if (t->run_status == 128 + SIGINT) run_list_abort(t);
+    else run_list_continue(t, tab_number);
+}
+
+/* Output a tab takes from its jobs per pass of the event loop. The rest
+ * stays in the pipes, so a producer faster than the tab can draw blocks
+ * in write() instead of growing scrollback. */
+#define TAB_READ_BUDGET (64 * 1024)
+
+/* Main loop pacing: how long one pass may spend reading tabs before the
+ * rest wait a turn, the redraw interval for output, and the cursor blink. */
+#define SCHED_SLICE_US 4000
+#define FRAME_US 16667
+#define BLINK_US 500000
+
+/* Reads at most budget bytes of a job's output into the tab; EOF may
+ * finish the job. Returns the bytes read. */
+static size_t job_read(Tab *t, Job *j, int tab_number, size_t budget)
+{
+    uint64_t ts = trace_begin();
+    char rbuf[4096];
+    size_t got = 0;
+    ssize_t rn = -1;
+    errno = EAGAIN;
+    while (got < budget) 
+    {
+        size_t want = budget - got < sizeof(rbuf) ? budget - got : sizeof(rbuf);
+        rn = read(j->out_fd, rbuf, want);
+        if (rn <= 0) break;
+        append_stream(t, j->stream_line, &j->stream_len, rbuf, (int)rn);
+        got += (size_t)rn;
+    }
+    if (rn == 0 || (rn < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) 
+    {
+        flush_stream(t, j->stream_line, &j->stream_len);
+        close(j->out_fd);
+        j->out_fd = -1;
+        job_check(t, j, tab_number);
+    }
+    trace_end("read + append_text", ts, "tab", tab_number, "bytes", (int64_t)got);
+    return got;
+}
+
+/* Takes line batches from the I/O workers, up to IO_DRAIN_BUDGET bytes
+ * of output per call, into the tabs whose jobs they belong to. Returns 1
+ * if batches were left for the next pass. */
+static int io_drain(Tab *tabs, int tab_count)
+{
+    uint64_t ts = trace_begin();
+    size_t taken = 0;
+    uint64_t count;
+    ssize_t n = read(io_event_fd, &count, sizeof(count));
+    (void)n;
+    for (int w = 0; w < io_worker_count; ++w) 
+    {
+        IoBatch b;
+        int popped = 0;
+        while (taken < IO_DRAIN_BUDGET && io_ring_pop(io_workers[w], &b)) 
+        {
+            popped = 1;
+            taken += b.bytes;
+            Job *j = b.stream->job;
+            int ti = 0;
+            Tab *t = NULL;
+            for (ti = 0; j && !t && ti < tab_count; ++ti)
+                for (int k = 0; k < tabs[ti].njobs; ++k)
+                    if (tabs[ti].jobs[k] == j) { t = &tabs[ti]; break; }
+            const char *line = b.text;
+            if (t) perf_add(&t->bytes_in, b.bytes);
+            for (int i = 0; t && i < b.nlines; ++i) 
+            {
+                push_line(t, line);
+                line += strlen(line) + 1;
+            }
+            free(b.text);
+            if (t && b.nlines) scroll_to_cursor(t);
+            if (!b.eof) continue;
+            free(b.stream);
+            if (!t) continue;
+            j->io = NULL;
+            job_check(t, j, ti);
+        }
+        if (popped) io_notify_space(io_workers[w]);
+    }
+    trace_end("io_drain", ts, "bytes", (int64_t)taken, NULL, 0);
+    for (int w = 0; w < io_worker_count; ++w)
+        if (atomic_load(&io_workers[w]->tail) != atomic_load(&io_workers[w]->head)) return 1;
+    return 0;
+}
+
+/* Starts a freshly entered line in the tab. */
+static void run_line_in_tab(Tab *t, const char *line, int tab_number)
+{
+    if (t->run_line) 
+    {
+        push_line(t, "myterm: a command is still running in this tab");
+        scroll_to_cursor(t);
+        return;
+    }
+    ParsedLine *pl = parse_line_cached(line);
+    if (!pl) 
+    {
+        push_line(t, "myterm: out of memory");
+        t->run_status = 1;
+        return;
+    }
+    if (pl->error) 
+    {
+        push_line(t, pl->error);
+        scroll_to_cursor(t);
+        parsed_line_release(pl);
+        t->run_status = 2;
+        return;
+    }
+    t->run_line = pl;
+    t->run_next = 0;
+    t->run_status = 0;
+    run_list_continue(t, tab_number);
+}
+
+/* The one place children are waited for, run whenever the SIGCHLD
+ * signalfd is readable. Stops and continues update the owning job; a
+ * stopped foreground job goes to the background and ends its list. Exits
+ * add to the job's rusage, and its last stage carries its status.
+ * multiWatch runs carry their stats. */
+static void reap_children(Tab *tabs, int tab_count)
+{
+    int status;
+    struct rusage ru;
+    pid_t pid;
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &ru)) > 0) 
+    {
+        Job *j = NULL;
+        int ti = 0, slot = 0;
+        for (ti = 0; ti < tab_count && !j; ++ti)
+            for (int n = 0; n < tabs[ti].njobs && !j; ++n)
+                for (slot = 0; slot < tabs[ti].jobs[n]->npids; ++slot)
+                    if (tabs[ti].jobs[n]->pids[slot] == pid) { j = tabs[ti].jobs[n]; break; }
+        if (!j) 
+        {
+            if (WIFEXITED(status) || WIFSIGNALED(status))
+                mw_child_exited(tabs, tab_count, pid, status, &ru);
+            continue;
+        }
+        Tab *t = &tabs[ti - 1];
+        if (WIFSTOPPED(status)) 
+        {
+            if (j->state == JOB_STOPPED) continue;
+            j->state = JOB_STOPPED;
+            j->background = 1;
+            if (t->fg == j) 
+            {
+                t->fg = NULL;
+                run_list_abort(t);
+            }
+            job_report(t, j, 0, 0);
+            continue;
+        }
+        if (WIFCONTINUED(status)) 
+        {
+            j->state = JOB_RUNNING;
+            continue;
+        }
+        j->pids[slot] = -1;
+        j->nlive--;
+        j->cpu_us += (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+                     (uint64_t)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+        if (ru.ru_maxrss > j->maxrss_kb) j->maxrss_kb = ru.ru_maxrss;
+        if (pid == j->last_pid)
+            j->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        job_check(t, j, ti);
+    }
+}
+
+/* What the event loop carries between passes. */
+typedef struct {
+    int sigchld_fd;
+    int sched_next;
+    int io_pending;
+} LoopState;
+
+/* Event loop timings, recorded whether or not the HUD shows them: the
+ * last frame's draw time and running totals, the last loop pass without
+ * its wait, and the last select wait. */
+typedef struct {
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t frame_us;
+    atomic_uint_fast64_t frame_total_us;
+    atomic_uint_fast64_t loop_us;
+    atomic_uint_fast64_t wait_us;
+    atomic_uint_fast64_t wait_total_us;
+} PerfCounters;
+
+static PerfCounters perf;
+
+static void perf_set(atomic_uint_fast64_t *c, uint64_t v)
+{
+    atomic_store_explicit(c, v, memory_order_relaxed);
+}
+
+static uint64_t perf_get(atomic_uint_fast64_t *c)
+{
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+/* One pass over everything but X. Sleeps up to wait_us (at most 10 ms)
+ * until output, a child or wake_fd is ready. Ready tabs then take turns
+ * from sched_next. Once the slice is used up, or should_yield reports
+ * waiting input, the rest wait for the next pass and the tab after the
+ * last one served goes first. Children are reaped and background polls
+ * run. Returns 1 if anything changed that needs drawing. */
+static int loop_service(Tab *tabs, int tab_count, int active, LoopState *ls, int wake_fd,
+                        uint64_t wait_us, int (*should_yield)(void *), void *arg)
+{
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    int maxfd = -1;
+    int extra[3] = { wake_fd, ls->sigchld_fd, io_event_fd };
+    for (int e = 0; e < 3; ++e) 
+    {
+        if (extra[e] < 0) continue;
+        FD_SET(extra[e], &readfds);
+        if (extra[e] > maxfd) maxfd = extra[e];
+    }
+    for (int i = 0; i < tab_count; ++i) {
+        Tab *tt = &tabs[i];
+        for (int j = 0; j < tt->njobs; ++j) {
+            int fd = tt->jobs[j]->out_fd;
+            if (fd >= 0) {
+                FD_SET(fd, &readfds);
+                if (fd > maxfd) maxfd = fd;
+            }
+        }
+        for (int m = 0; tt->mw && m < tt->mw->n; ++m) {
+            int fd = tt->mw->cmds[m].fd;
+            if (fd >= 0) {
+                FD_SET(fd, &readfds);
+                if (fd > maxfd) maxfd = fd;
+            }
+        }
+    }
+
+    int changed = 0;
+    if (ls->io_pending) wait_us = 0;
+    if (wait_us > 10000) wait_us = 10000;
+    struct timeval tv = { 0, (suseconds_t)wait_us };
+    int reap_now = ls->sigchld_fd < 0;
+    uint64_t wait_start = monotonic_us();
+    int ready = select(maxfd+1, &readfds, NULL, NULL, &tv);
+    uint64_t waited = monotonic_us() - wait_start;
+    trace_end("select", wait_start, "ready", ready, NULL, 0);
+    perf_set(&perf.wait_us, waited);
+    perf_add(&perf.wait_total_us, waited);
+    if (ls->io_pending || (ready > 0 && io_event_fd >= 0 && FD_ISSET(io_event_fd, &readfds))) {
+        ls->io_pending = io_drain(tabs, tab_count);
+        changed = 1;
+    }
+    if (ready > 0) {
+        if (ls->sigchld_fd >= 0 && FD_ISSET(ls->sigchld_fd, &readfds)) reap_now = 1;
+        uint64_t slice_end = monotonic_us() + SCHED_SLICE_US;
+        int served = 0;
+        for (; served < tab_count; ++served) {
+            int i = (ls->sched_next + served) % tab_count;
+            Tab *tt = &tabs[i];
+            uint64_t ts = trace_begin();
+            int nready = 0;
+            for (int j = 0; j < tt->njobs; ++j)
+                if (tt->jobs[j]->out_fd >= 0 && FD_ISSET(tt->jobs[j]->out_fd, &readfds)) nready++;
+            /* Ready jobs split the tab's budget evenly. job_read may
+             * finish a job, which drops it from the table and may
+             * start the list's next one at the end. */
+            size_t share = nready ? TAB_READ_BUDGET / nready : 0;
+            int got = 0;
+            for (int j = 0; nready && j < tt->njobs; ++j) {
+                Job *jb = tt->jobs[j];
+                if (jb->out_fd < 0 || !FD_ISSET(jb->out_fd, &readfds)) continue;
+                job_read(tt, jb, i + 1, share);
+                if (j < tt->njobs && tt->jobs[j] != jb) j--;
+                got = 1;
+            }
+            for (int m = 0; tt->mw && m < tt->mw->n; ++m) {
+                MWCommand *mc = &tt->mw->cmds[m];
+                if (mc->fd >= 0 && FD_ISSET(mc->fd, &readfds)) {
+                    mw_handle_readable(tt, mc);
+                    got = 1;
+                }
+            }
+            if (!got) continue;
+            trace_end("tab", ts, "tab", i + 1, NULL, 0);
+            changed = 1;
+            if (i == active) scroll_to_cursor(tt);
+            if (monotonic_us() >= slice_end || (should_yield && should_yield(arg))) {
+                served++;
+                break;
+            }
+        }
+        ls->sched_next = (ls->sched_next + (served < tab_count ? served : 1)) % tab_count;
+    }
+
+    if (reap_now) 
+    {
+        struct signalfd_siginfo si;
+        while (ls->sigchld_fd >= 0 && read(ls->sigchld_fd, &si, sizeof(si)) == (ssize_t)sizeof(si))
+            ;
+        uint64_t ts = trace_begin();
+        reap_children(tabs, tab_count);
+        trace_end("reap", ts, NULL, 0, NULL, 0);
+        changed = 1;
+    }
+    mw_wheel_advance(monotonic_ms());
+    path_index_poll();
+    for (int i = 0; i < tab_count; ++i)
+        if (autocomplete_poll(&tabs[i])) changed = 1;
+    return changed;
+}
+
+static int x_input_waiting(void *display)
+{
+    return XEventsQueued((Display *)display, QueuedAfterReading) > 0;
+}
+
+/* What drawing needs from a backend. Text y is the baseline; a clear
+ * with w or h of 0 reaches the edge, as XClearArea does, and a clip with
+ * w <= 0 removes the clip. The Xlib backend draws into the window, the
+ * null one only counts the work layout asks for, and the offscreen one
+ * paints glyph cells into a memory framebuffer, so rendering can be timed
+ * and compared without an X server. */
+typedef struct Renderer {
+    int  (*text_width)(struct Renderer *r, const char *s, int len);
+    void (*text)(struct Renderer *r, int x, int y, const char *s, int len);
+    void (*fill_rect)(struct Renderer *r, int x, int y, int w, int h);
+    void (*rect)(struct Renderer *r, int x, int y, int w, int h);
+    void (*line)(struct Renderer *r, int x1, int y1, int x2, int y2);
+    void (*clear)(struct Renderer *r, int x, int y, int w, int h);
+    void (*clip)(struct Renderer *r, int x, int y, int w, int h);
+    void (*flush)(struct Renderer *r);
+    uint64_t ops;
+    uint64_t glyphs;
+} Renderer;
+
+typedef struct {
+    Renderer base;
+    Display *display;
+    Window win;
+    GC gc;
+    XFontStruct *font;
+} XlibRenderer;
+
+static int xr_text_width(Renderer *r, const char *s, int len)
+{
+    return utf8_text_width(((XlibRenderer *)r)->font, s, len);
+}
+
+static void xr_text(Renderer *r, int x, int y, const char *s, int len)
+{
+    XlibRenderer *xr = (XlibRenderer *)r;
+    if (fontset) Xutf8DrawString(xr->display, xr->win, fontset, xr->gc, x, y, s, len);
+    else XDrawString(xr->display, xr->win, xr->gc, x, y, s, len);
+}
+
+static void xr_fill_rect(Renderer *r, int x, int y, int w, int h)
+{
+    XlibRenderer *xr = (XlibRenderer *)r;
+    XFillRectangle(xr->display, xr->win, xr->gc, x, y, (unsigned)w, (unsigned)h);
+}
+
+static void xr_rect(Renderer *r, int x, int y, int w, int h)
+{
+    XlibRenderer *xr = (XlibRenderer *)r;
+    XDrawRectangle(xr->display, xr->win, xr->gc, x, y, (unsigned)w, (unsigned)h);
+}
+
+static void xr_line(Renderer *r, int x1, int y1, int x2, int y2)
+{
+    XlibRenderer *xr = (XlibRenderer *)r;
+    XDrawLine(xr->display, xr->win, xr->gc, x1, y1, x2, y2);
+}
+
+static void xr_clear(Renderer *r, int x, int y, int w, int h)
+{
+    XlibRenderer *xr = (XlibRenderer *)r;
+    XClearArea(xr->display, xr->win, x, y, (unsigned)w, (unsigned)h, False);
+}
+
+static void xr_clip(Renderer *r, int x, int y, int w, int h)
+{
+    XlibRenderer *xr = (XlibRenderer *)r;
+    if (w <= 0) 
+    {
+        XSetClipMask(xr->display, xr->gc, None);
+        return;
+    }
+    XRectangle clip = { (short)x, (short)y, (unsigned short)w, (unsigned short)h };
+    XSetClipRectangles(xr->display, xr->gc, 0, 0, &clip, 1, Unsorted);
+}
+
+static void xr_flush(Renderer *r)
+{
+    XFlush(((XlibRenderer *)r)->display);
+}
+
+static Renderer *xlib_renderer_init(XlibRenderer *xr, Display *display, Window win, GC gc, XFontStruct *font)
+{
+    memset(xr, 0, sizeof(*xr));
+    xr->base.text_width = xr_text_width;
+    xr->base.text = xr_text;
+    xr->base.fill_rect = xr_fill_rect;
+    xr->base.rect = xr_rect;
+    xr->base.line = xr_line;
+    xr->base.clear = xr_clear;
+    xr->base.clip = xr_clip;
+    xr->base.flush = xr_flush;
+    xr->display = display;
+    xr->win = win;
+    xr->gc = gc;
+    xr->font = font;
+    return &xr->base;
+}
+
+/* Without a font every code point gets a fixed cell. */
+#define CELL_WIDTH 8
+
+static int utf8_cells(const char *s, int len)
+{
+    int n = 0;
+    for (int i = 0; i < len; ++i)
+        if (!is_utf8_continuation((unsigned char)s[i])) n++;
+    return n;
+}
+
+static int null_text_width(Renderer *r, const char *s, int len)
+{
+    (void)r;
+    return utf8_cells(s, len) * CELL_WIDTH;
+}
+
+static void null_text(Renderer *r, int x, int y, const char *s, int len)
+{
+    (void)x; (void)y;
+    r->ops++;
+    r->glyphs += (uint64_t)utf8_cells(s, len);
+}
+
+static void null_box(Renderer *r, int x, int y, int w, int h)
+{
+    (void)x; (void)y; (void)w; (void)h;
+    r->ops++;
+}
+
+static void null_flush(Renderer *r)
+{
+    (void)r;
+}
+
+static Renderer *null_renderer_init(Renderer *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->text_width = null_text_width;
+    r->text = null_text;
+    r->fill_rect = null_box;
+    r->rect = null_box;
+    r->line = null_box;
+    r->clear = null_box;
+    r->clip = null_box;
+    r->flush = null_flush;
+    return r;
+}
+
+/* A w x h framebuffer of 0xRRGGBB pixels: white on black like the window.
+ * Each glyph is a solid cell with a gap where the X backend would leave
+ * the glyph's spacing, and a column per byte value, so different text
+ * gives different pixels. */
+typedef struct {
+    Renderer base;
+    uint32_t *pixels;
+    int w;
+    int h;
+    int clip_x, clip_y, clip_w, clip_h;
+} OffscreenRenderer;
+
+static void off_fill(OffscreenRenderer *o, int x, int y, int w, int h, uint32_t color)
+{
+    int x0 = x > o->clip_x ? x : o->clip_x;
+    int y0 = y > o->clip_y ? y : o->clip_y;
+    int x1 = x + w < o->clip_x + o->clip_w ? x + w : o->clip_x + o->clip_w;
+    int y1 = y + h < o->clip_y + o->clip_h ? y + h : o->clip_y + o->clip_h;
+    for (int py = y0; py < y1; ++py)
+        for (int px = x0; px < x1; ++px)
+            o->pixels[(size_t)py * (size_t)o->w + (size_t)px] = color;
+}
+
+static void off_text(Renderer *r, int x, int y, const char *s, int len)
+{
+    OffscreenRenderer *o = (OffscreenRenderer *)r;
+    r->ops++;
+    for (int i = 0; i < len; ) 
+    {
+        unsigned char c = (unsigned char)s[i++];
+        while (i < len && is_utf8_continuation((unsigned char)s[i])) i++;
+        r->glyphs++;
+        if (c != ' ') 
+        {
+            off_fill(o, x + 1, y - font_ascent + 2, CELL_WIDTH - 2, font_ascent - 2, 0xFFFFFF);
+            off_fill(o, x + 1 + c % (CELL_WIDTH - 2), y - font_ascent + 2, 1, font_ascent - 2, 0x000000);
+        }
+        x += CELL_WIDTH;
+    }
+}
+
+static void off_fill_rect(Renderer *r, int x, int y, int w, int h)
+{
+    r->ops++;
+    off_fill((OffscreenRenderer *)r, x, y, w, h, 0xFFFFFF);
+}
+
+static void off_rect(Renderer *r, int x, int y, int w, int h)
+{
+    OffscreenRenderer *o = (OffscreenRenderer *)r;
+    r->ops++;
+    off_fill(o, x, y, w + 1, 1, 0xFFFFFF);
+    off_fill(o, x, y + h, w + 1, 1, 0xFFFFFF);
+    off_fill(o, x, y, 1, h + 1, 0xFFFFFF);
+    off_fill(o, x + w, y, 1, h + 1, 0xFFFFFF);
+}
+
+/* The UI only draws horizontal and vertical lines. */
+static void off_line(Renderer *r, int x1, int y1, int x2, int y2)
+{
+    OffscreenRenderer *o = (OffscreenRenderer *)r;
+    r->ops++;
+    int x = x1 < x2 ? x1 : x2, y = y1 < y2 ? y1 : y2;
+    off_fill(o, x, y, abs(x2 - x1) + 1, abs(y2 - y1) + 1, 0xFFFFFF);
+}
+
+static void off_clear(Renderer *r, int x, int y, int w, int h)
+{
+    OffscreenRenderer *o = (OffscreenRenderer *)r;
+    r->ops++;
+    off_fill(o, x, y, w > 0 ? w : o->w - x, h > 0 ? h : o->h - y, 0x000000);
+}
+
+static void off_clip(Renderer *r, int x, int y, int w, int h)
+{
+    OffscreenRenderer *o = (OffscreenRenderer *)r;
+    if (w <= 0) 
+    {
+        x = y = 0;
+        w = o->w;
+        h = o->h;
+    }
+    o->clip_x = x < 0 ? 0 : x;
+    o->clip_y = y < 0 ? 0 : y;
+    o->clip_w = x + w > o->w ? o->w - o->clip_x : x + w - o->clip_x;
+    o->clip_h = y + h > o->h ? o->h - o->clip_y : y + h - o->clip_y;
+}
+
+static Renderer *offscreen_renderer_init(OffscreenRenderer *o, int w, int h)
+{
+    memset(o, 0, sizeof(*o));
+    o->pixels = calloc((size_t)w * (size_t)h, sizeof(uint32_t));
+    if (!o->pixels) return NULL;
+    o->w = w;
+    o->h = h;
+    o->base.text_width = null_text_width;
+    o->base.text = off_text;
+    o->base.fill_rect = off_fill_rect;
+    o->base.rect = off_rect;
+    o->base.line = off_line;
+    o->base.clear = off_clear;
+    o->base.clip = off_clip;
+    o->base.flush = null_flush;
+    off_clip(&o->base, 0, 0, 0, 0);
+    return &o->base;
+}
+
+/* FNV-1a over the framebuffer, for comparing frames. */
+static uint64_t offscreen_checksum(const OffscreenRenderer *o)
+{
+    uint64_t h = 1469598103934665603ULL;
+    const unsigned char *p = (const unsigned char *)o->pixels;
+    for (size_t i = 0; i < (size_t)o->w * (size_t)o->h * sizeof(uint32_t); ++i) 
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int offscreen_write_ppm(const OffscreenRenderer *o, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    fprintf(f, "P6\n%d %d\n255\n", o->w, o->h);
+    for (size_t i = 0; i < (size_t)o->w * (size_t)o->h; ++i) 
+    {
+        unsigned char rgb[3] = { (unsigned char)(o->pixels[i] >> 16), (unsigned char)(o->pixels[i] >> 8),
+                                 (unsigned char)o->pixels[i] };
+        fwrite(rgb, 1, 3, f);
+    }
+    return fclose(f);
+}
+
+static void draw_input_line(Renderer *r, Tab *t,
+                            int active, int tab_count, int search_mode, char *search_buf, int search_len,
+                            int search_cursor, int input_baseline)
+{
+    const char *prompt = "user@myterm> ";
+    int prompt_width = r->text_width(r, prompt, (int)strlen(prompt));
+    r->text(r, LEFT_MARGIN, input_baseline, prompt, (int)strlen(prompt));
+
+    if (search_mode) {
+        const char *sp = "Enter search term: ";
+        int spw = r->text_width(r, sp, (int)strlen(sp));
+        r->text(r, LEFT_MARGIN + prompt_width, input_baseline, sp, (int)strlen(sp));
+        if (search_len > 0)
+            r->text(r, LEFT_MARGIN + prompt_width + spw, input_baseline, search_buf, search_len);
+    } else if (t->current_len > 0) {
+        r->text(r, LEFT_MARGIN + prompt_width, input_baseline, t->current_line, t->current_len);
+    }
+
+    char tb[64];
+    if (t->autocomplete_req)
+        snprintf(tb, sizeof(tb), "completing (%d)  [Tab %d/%d]", t->autocomplete_count, active + 1, tab_count);
+    else
+        snprintf(tb, sizeof(tb), "[Tab %d/%d]", active + 1, tab_count);
+    int tw = r->text_width(r, tb, (int)strlen(tb));
+    r->text(r, WIDTH - LEFT_MARGIN - tw, TOP_MARGIN - 6, tb, (int)strlen(tb));
+
+    if (cursor_visible) {
+        int cursor_x;
+        if (search_mode) {
+            const char *sp = "Enter search term: ";
+            int spw = r->text_width(r, sp, (int)strlen(sp));
+            cursor_x = LEFT_MARGIN + prompt_width + spw +
+                       r->text_width(r, search_buf, search_cursor);
+        } else {
+            cursor_x = LEFT_MARGIN + prompt_width +
+                       r->text_width(r, t->current_line, t->cursor_pos);
+        }
+        int cursor_h = font_ascent + font_descent;
+        int cursor_w = 4;
+        int cursor_y = input_baseline - font_ascent;
+        r->fill_rect(r, cursor_x, cursor_y, cursor_w, cursor_h);
+    }
+
+}
+
+static void draw_dashboard(Renderer *r, Tab *t,
+                           int active, int tab_count, int search_mode, char *search_buf, int search_len,
+                           int search_cursor)
+{
+    static MWSession *last_session = NULL;
+    MWSession *ms = t->mw;
+    int full = dashboard_full_redraw || ms != last_session;
+    last_session = ms;
+    dashboard_full_redraw = 0;
+    if (full) r->clear(r, 0, 0, 0, 0);
+
+    int input_baseline = HEIGHT - FONT_HEIGHT;
+    int area_top = TOP_MARGIN;
+    int area_h = input_baseline - font_ascent - 2 - area_top;
+    int cols = 1;
+    while (cols * cols < ms->n) cols++;
+    int rows = (ms->n + cols - 1) / cols;
+    int pw = WIDTH / cols;
+    int ph = area_h / rows;
+    int per_pane = ph / FONT_HEIGHT - 1;
+
+    for (int i = 0; i < ms->n; ++i) 
+    {
+        MWCommand *mc = &ms->cmds[i];
+        if (!full && !mc->pane_dirty) continue;
+        mc->pane_dirty = 0;
+        int x = (i % cols) * pw;
+        int y = area_top + (i / cols) * ph;
+        if (!full) r->clear(r, x, y, pw, ph);
+        r->rect(r, x, y, pw - 1, ph - 1);
+
+        r->clip(r, x + 1, y + 1, pw - 2, ph - 2);
+        char title[MAX_LINE_LEN + 64];
+        if (mc->pane_time) 
+        {
+            char tstr[16];
+            strftime(tstr, sizeof(tstr), "%H:%M:%S", localtime(&mc->pane_time));
+            snprintf(title, sizeof(title), "%s  [%s]", mc->cmd, tstr);
+        } 
+        else 
+        {
+            snprintf(title, sizeof(title), "%s  [waiting]", mc->cmd);
+        }
+        int ty = y + font_ascent + 2;
+        r->text(r, x + LEFT_MARGIN, ty, title, (int)strlen(title));
+        r->line(r, x, ty + font_descent, x + pw - 1, ty + font_descent);
+        for (int li = 0; li < mc->pane_n && li < per_pane; ++li) 
+        {
+            int ly = ty + (li + 1) * FONT_HEIGHT;
+            const char *line = mc->pane_lines[li];
+            r->text(r, x + LEFT_MARGIN, ly, line, (int)strlen(line));
+        }
+        r->clip(r, 0, 0, 0, 0);
+    }
+
+    if (!full) 
+    {
+        r->clear(r, 0, 0, WIDTH, area_top);
+        r->clear(r, 0, input_baseline - font_ascent - 1, WIDTH,
+                 HEIGHT - (input_baseline - font_ascent - 1));
+    }
+    draw_input_line(r, t, active, tab_count, search_mode, search_buf, search_len,
+                    search_cursor, input_baseline);
+}
+
+/* Performance overlay, toggled with Ctrl+Shift+P. hud_sample runs about
+ * once a second whether or not the overlay is shown and turns the
+ * counters into rates; draw_hud only prints the last sample and the
+ * latest timings, so showing it does not move the numbers. */
+#define HUD_MAX_TAB_ROWS 8
+
+typedef struct {
+    uint64_t at_us;
+    uint64_t frames;
+    double redraws_per_s;
+    int tabs;
+    uint64_t bytes[MAX_TABS];
+    uint64_t lines[MAX_TABS];
+    double bytes_per_s[MAX_TABS];
+    double lines_per_s[MAX_TABS];
+    size_t scrollback[MAX_TABS];
+    int history;
+    int dirs;
+    long dir_names;
+    int path_names;
+    int parsed;
+} HudSample;
+
+static int hud_visible = 0;
+static HudSample hud;
+
+static int hud_sample(Tab *tabs, int tab_count)
+{
+    uint64_t now = monotonic_us();
+    if (hud.at_us && now - hud.at_us < 1000000) return 0;
+    double secs = hud.at_us ? (now - hud.at_us) / 1e6 : 0.0;
+    uint64_t frames = perf_get(&perf.frames);
+    hud.redraws_per_s = secs > 0 ? (frames - hud.frames) / secs : 0.0;
+    hud.frames = frames;
+    hud.tabs = tab_count;
+    for (int i = 0; i < tab_count; ++i) 
+    {
+        uint64_t b = perf_get(&tabs[i].bytes_in);
+        uint64_t l = perf_get(&tabs[i].lines_in);
+        /* Closing a tab shifts the rest down; their rates restart. */
+        hud.bytes_per_s[i] = secs > 0 && b >= hud.bytes[i] ? (b - hud.bytes[i]) / secs : 0.0;
+        hud.lines_per_s[i] = secs > 0 && l >= hud.lines[i] ? (l - hud.lines[i]) / secs : 0.0;
+        hud.bytes[i] = b;
+        hud.lines[i] = l;
+        hud.scrollback[i] = tabs[i].scroll_bytes;
+    }
+    hud.history = history_count;
+    hud.dirs = 0;
+    hud.dir_names = 0;
+    pthread_mutex_lock(&dir_cache_lock);
+    for (int i = 0; i < DIR_CACHE_SLOTS; ++i) 
+    {
+        if (!dir_cache[i]) continue;
+        hud.dirs++;
+        hud.dir_names += dir_cache[i]->count;
+    }
+    pthread_mutex_unlock(&dir_cache_lock);
+    pthread_mutex_lock(&path_index_lock);
+    hud.path_names = path_index.count;
+    pthread_mutex_unlock(&path_index_lock);
+    hud.parsed = 0;
+    for (int i = 0; i < PARSE_CACHE_SLOTS; ++i)
+        if (parse_cache[i]) hud.parsed++;
+    hud.at_us = now;
+    return 1;
+}
+
+/* Formats v with a K/M/G suffix. */
+static const char *hud_amount(char *buf, size_t cap, double v)
+{
+    const char *unit = "";
+    if (v >= 1e9) { v /= 1e9; unit = "G"; }
+    else if (v >= 1e6) { v /= 1e6; unit = "M"; }
+    else if (v >= 1e3) { v /= 1e3; unit = "K"; }
+    snprintf(buf, cap, "%.1f%s", v, unit);
+    return buf;
+}
+
+static void draw_hud(Renderer *r, int active)
+{
+    char rows[HUD_MAX_TAB_ROWS + 4][160];
+    int n = 0;
+    uint64_t frames = perf_get(&perf.frames);
+    double avg_frame = frames ? perf_get(&perf.frame_total_us) / (double)frames : 0.0;
+    snprintf(rows[n++], sizeof(rows[0]), "frame %.2f ms (avg %.2f)  %.0f redraws/s",
+             perf_get(&perf.frame_us) / 1000.0, avg_frame / 1000.0, hud.redraws_per_s);
+    snprintf(rows[n++], sizeof(rows[0]), "loop %.2f ms  wait %.2f ms",
+             perf_get(&perf.loop_us) / 1000.0, perf_get(&perf.wait_us) / 1000.0);
+    snprintf(rows[n++], sizeof(rows[0]), "history %d  dirs %d (%ld names)  path %d  parse %d/%d",
+             hud.history, hud.dirs, hud.dir_names, hud.path_names, hud.parsed, PARSE_CACHE_SLOTS);
+    for (int i = 0; i < hud.tabs && i < HUD_MAX_TAB_ROWS; ++i) 
+    {
+        char b[16], l[16], m[16];
+        snprintf(rows[n++], sizeof(rows[0]), "%ctab %d: %sB/s  %s lines/s  scrollback %sB",
+                 i == active ? '*' : ' ', i + 1,
+                 hud_amount(b, sizeof(b), hud.bytes_per_s[i]), hud_amount(l, sizeof(l), hud.lines_per_s[i]),
+                 hud_amount(m, sizeof(m), (double)hud.scrollback[i]));
+    }
+    if (hud.tabs > HUD_MAX_TAB_ROWS)
+        snprintf(rows[n++], sizeof(rows[0]), " ... %d more tabs", hud.tabs - HUD_MAX_TAB_ROWS);
+
+    int w = 0;
+    for (int i = 0; i < n; ++i) 
+    {
+        int tw = r->text_width(r, rows[i], (int)strlen(rows[i]));
+        if (tw > w) w = tw;
+    }
+    w += 2 * LEFT_MARGIN;
+    int h = n * FONT_HEIGHT + font_descent + 4;
+    int x = WIDTH - LEFT_MARGIN - w;
+    if (x < 0) x = 0;
+    int y = TOP_MARGIN;
+    r->clear(r, x, y, w, h);
+    r->rect(r, x, y, w, h);
+    for (int i = 0; i < n; ++i)
+        r->text(r, x + LEFT_MARGIN, y + 2 + font_ascent + i * FONT_HEIGHT, rows[i], (int)strlen(rows[i]));
+}
+
+static void draw_tab_view(Renderer *r, Tab *t,
+                          int active, int tab_count, int search_mode, char *search_buf, int search_len,
+                          int search_cursor)
+{
+    static int last_was_dashboard = 0;
+    if (t->mw && t->mw->panes) 
+    {
+        if (!last_was_dashboard) dashboard_full_redraw = 1;
+        last_was_dashboard = 1;
+        draw_dashboard(r, t, active, tab_count, search_mode, search_buf, search_len,
+                       search_cursor);
+        return;
+    }
+    last_was_dashboard = 0;
+
+    r->clear(r, 0, 0, 0, 0);
+    int max_visible_history = (HEIGHT - TOP_MARGIN - FONT_HEIGHT) / FONT_HEIGHT;
+    if (max_visible_history < 1) max_visible_history = 1;
+
+    if (t->scroll_offset < 0) t->scroll_offset = 0;
+    if (t->scroll_offset > t->lines_count) t->scroll_offset = t->lines_count;
+
+    int start = t->scroll_offset;
+    int end = start + max_visible_history;
+    if (end > t->lines_count) end = t->lines_count;
+
+    int y = TOP_MARGIN;
+    for (int li = start; li < end; ++li) {
+         if (t->lines[li]) {
+            char linebuf[MAX_LINE_LEN + 64];
+            if (t->is_command[li]) {
+                snprintf(linebuf, sizeof(linebuf), "user@myterm> %s", t->lines[li]);
+            } else {
+                snprintf(linebuf, sizeof(linebuf), "%s", t->lines[li]);
+            }
+            r->text(r, LEFT_MARGIN, y, linebuf, (int)strlen(linebuf));
+        }
+        y += FONT_HEIGHT;
+    }
+
+    int input_baseline;
+    if (t->lines_count == 0)
+        input_baseline = TOP_MARGIN + FONT_HEIGHT * 1;
+    else
+        input_baseline = y;
+
+    if (input_baseline > HEIGHT - FONT_HEIGHT)
+        input_baseline = HEIGHT - FONT_HEIGHT;
+
+    draw_input_line(r, t, active, tab_count, search_mode, search_buf, search_len,
+                    search_cursor, input_baseline);
+}
+
+/* Draws the active tab and, when enabled, the HUD over it. The frame time
+ * recorded is the tab's own drawing, without the HUD. */
+void draw_ui(Renderer *r, Tab *t,
+                    int active, int tab_count, int search_mode, char *search_buf, int search_len, int search_cursor)
+{
+    uint64_t start = monotonic_us();
+    draw_tab_view(r, t, active, tab_count, search_mode, search_buf, search_len, search_cursor);
+    uint64_t took = monotonic_us() - start;
+    trace_end("draw_ui", start, "tab", active + 1, "lines", t->lines_count);
+    perf_set(&perf.frame_us, took);
+    perf_add(&perf.frame_total_us, took);
+    perf_add(&perf.frames, 1);
+    if (hud_visible) draw_hud(r, active);
+    r->flush(r);
+}
+
+/* A multiWatch session never ends by itself. At the end of a script each
+ * command gets to finish one run (the one in flight, or its first), then
+ * nothing more is launched and the session is stopped as closing the tab
+ * would, so the output and the spill log are complete. */
+static void headless_finish_multiwatch(Tab *t, LoopState *loop)
+{
+    while (t->mw && !exit_requested) 
+    {
+        MWSession *ms = t->mw;
+        int pending = ms->running > 0;
+        for (int i = 0; i < ms->n; ++i) 
+        {
+            if (ms->cmds[i].runs > 0) mw_wheel_remove(&ms->cmds[i]);
+            else pending = 1;
+        }
+        if (!pending) break;
+        loop_service(t, 1, 0, loop, -1, 10000, NULL, NULL);
+    }
+    stop_multiwatch_tab(t);
+}
+
+/* --batch FILE or --headless (commands from stdin): runs each command
+ * line through one tab with no display, copying every line the tab
+ * prints to stdout or the --output file. A line runs to completion
+ * before the next is read; running background jobs are waited for at
+ * the end, and a multiWatch session is wound down. The tab is still laid out after every line, into the null
+ * renderer, or the offscreen one when --snapshot FILE asks for the last
+ * frame as a PPM. Returns the last line's status. */
+static int run_headless(const char *script, const char *output, const char *snapshot, int sigchld_fd)
+{
+    FILE *in = script ? fopen(script, "r") : stdin;
+    if (!in) 
+    {
+        perror(script);
+        return 2;
+    }
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) 
+    {
+        perror(output);
+        if (in != stdin) fclose(in);
+        return 2;
+    }
+    line_sink = out;
+    jobs_stdin_null = 1;
+    /* Scrolling still does layout; use the default font metrics. */
+    if (FONT_HEIGHT <= 0) FONT_HEIGHT = font_ascent + font_descent;
+
+    static Tab tab;
+    init_tab(&tab, NULL, 1);
+    LoopState loop = { sigchld_fd, 0, 0 };
+    Renderer null_rend;
+    OffscreenRenderer off;
+    Renderer *rend = snapshot ? offscreen_renderer_init(&off, WIDTH, HEIGHT) : null_renderer_init(&null_rend);
+    if (!rend) rend = null_renderer_init(&null_rend);
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while (!exit_requested && (len = getline(&line, &cap, in)) >= 0) 
+    {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = '\0';
+        if (len == 0) continue;
+        run_line_in_tab(&tab, line, 1);
+        while (tab.run_line && !exit_requested) loop_service(&tab, 1, 0, &loop, -1, 10000, NULL, NULL);
+        draw_ui(rend, &tab, 0, 1, 0, "", 0, 0);
+        fflush(out);
+    }
+    for (;;) 
+    {
+        int running = 0;
+        for (int i = 0; i < tab.njobs; ++i)
+            if (tab.jobs[i]->state == JOB_RUNNING) running = 1;
+        if (!running || exit_requested) break;
+        loop_service(&tab, 1, 0, &loop, -1, 10000, NULL, NULL);
+    }
+    headless_finish_multiwatch(&tab, &loop);
+    int status = tab.run_status;
+    if (rend != &null_rend) 
+    {
+        draw_ui(rend, &tab, 0, 1, 0, "", 0, 0);
+        if (offscreen_write_ppm(&off, snapshot) != 0) perror(snapshot);
+        else fprintf(stderr, "%s: frame %016llx\n", snapshot, (unsigned long long)offscreen_checksum(&off));
+        free(off.pixels);
+    }
+    destroy_tab(&tab);
+    free(line);
+    fflush(out);
+    line_sink = NULL;
+    jobs_stdin_null = 0;
+    if (out != stdout) fclose(out);
+    if (in != stdin) fclose(in);
+    return status;
+}
+
+/* Benchmarks include this file with MYTERM_NO_MAIN to reach its internals. */
+#ifndef MYTERM_NO_MAIN
+int main(int argc, char *argv[]) {
+    setlocale(LC_ALL, "");
+    const char *loc = setlocale(LC_CTYPE, NULL);
+    if (!loc || !strstr(loc, "UTF-8")) {
+        setenv("LANG", "en_US.UTF-8", 1);
+        setenv("LC_CTYPE", "en_US.UTF-8", 1);
+        setlocale(LC_ALL, "");
+    }
+    setenv("TZ", "Asia/Kolkata", 1);
+    tzset();
+
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_IGN);
+    /* Children are reaped from the event loop through a signalfd, so
+     * SIGCHLD stays blocked in every thread; spawn_stage unblocks it in
+     * the children. */
+    sigset_t chld_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, NULL);
+    int sigchld_fd = signalfd(-1, &chld_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (getenv("MYTERM_NATIVE") && strcmp(getenv("MYTERM_NATIVE"), "0") == 0) native_builtins = 0;
+    int io_threads = getenv("MYTERM_IO_THREADS") ? atoi(getenv("MYTERM_IO_THREADS")) : 0;
+    int headless = 0;
+    const char *batch_script = NULL, *batch_output = NULL, *snapshot = NULL, *trace_file = NULL;
+    for (int i = 1; i < argc; ++i) 
+    {
+        if (strcmp(argv[i], "--no-native") == 0) native_builtins = 0;
+        else if (strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) io_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--headless") == 0) headless = 1;
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) { headless = 1; batch_script = argv[++i]; }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) batch_output = argv[++i];
+        else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) snapshot = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_file = argv[++i];
+    }
+    srand((unsigned)time(NULL) ^ (unsigned)getpid());
+
+    if (trace_file && trace_start(trace_file) != 0) fprintf(stderr, "--trace: cannot allocate the trace ring\n");
+
+    history_path[0] = '\0';
+    load_history_file();
+    frecency_start();
+    path_index_init();
+    io_start(io_threads);
+    if (headless) return run_headless(batch_script, batch_output, snapshot, sigchld_fd);
+
+    Display *display = XOpenDisplay(NULL);
+    if (!display) {
+        fprintf(stderr, "Cannot open X display (use --headless or --batch FILE to run without one).\n");
+        return 1;
+    }
+    XFontStruct *font = NULL;
+
+    char **missing_list = NULL;
+    int missing_count = 0;
+    char *default_string = NULL;
+
+    fontset = XCreateFontSet(display,
+                             "-*-monospace-*-*-*-*-16-*-*-*-*-*-iso10646-1",
+                             &missing_list, &missing_count, &default_string);
+    if (fontset) {
+        XFontStruct **fs_list = NULL;
+        char **fn_list = NULL;
+        if (XFontsOfFontSet(fontset, &fs_list, &fn_list) > 0 && fs_list[0]) {
+            font_ascent = fs_list[0]->ascent;
+            font_descent = fs_list[0]->descent;
+        }
+    }
+
+    font = XLoadQueryFont(display, "fixed");
+    if (!font) {
+        fprintf(stderr, "Failed to load fallback font.\n");
+        XCloseDisplay(display);
+        return 1;
+    }
+    if (!fontset) {
+        font_ascent = font->ascent;
+        font_descent = font->descent;
+    }
+
+    FONT_HEIGHT = font_ascent + font_descent;
+    int screen = DefaultScreen(display);
+    Window root = RootWindow(display, screen);
+    Window win = XCreateSimpleWindow(display, root, 10, 10, WIDTH, HEIGHT, 1,
+                                     WhitePixel(display, screen), BlackPixel(display, screen));
+    XMapWindow(display, win);
+    GC gc = XCreateGC(display, win, 0, NULL);
+    XSetForeground(display, gc, WhitePixel(display, screen));
+    XSetBackground(display, gc, BlackPixel(display, screen));
+    XlibRenderer xrend;
+    Renderer *rend = xlib_renderer_init(&xrend, display, win, gc, font);
+    XSelectInput(display, win, KeyPressMask | ExposureMask | ButtonPressMask);
+    XSetFont(display, gc, font->fid);
+    if (!font) {
+        fprintf(stderr, "Cannot load font 'fixed'\n");
+        XCloseDisplay(display);
+        return 1;
+    }
+    XSetFont(display, gc, font->fid);
+
+    XIM xim = XOpenIM(display, NULL, NULL, NULL);
+    XIC xic = NULL;
+    if (xim) {
+        xic = XCreateIC(xim,
+                        XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
+                        XNClientWindow, win,
+                        NULL);
+    }
+
+    Tab tabs[MAX_TABS];
+    int tab_count = 1;
+    if (tab_count > MAX_TABS) tab_count = MAX_TABS;
+    int active = 0;
+    char basecwd[PATH_MAX];
+    if (getcwd(basecwd, sizeof(basecwd)) == NULL) basecwd[0] = '\0';
+    for (int i = 0; i < MAX_TABS; ++i) {
+        tabs[i].scroll_offset = 0;
+        init_tab(&tabs[i], basecwd, i+1);
+    }
+
+    int xfd = ConnectionNumber(display);
+    LoopState loop = { sigchld_fd, 0, 0 };
+    int dirty = 1;
+    uint64_t last_draw_us = 0, last_blink_us = monotonic_us();
+    int search_mode = 0;
+    char search_buf[MAX_LINE_LEN];
+    int search_len = 0;
+    int search_cursor = 0;
+    XEvent ev;
+
+    while (1) 
+    {
+        uint64_t pass_start = monotonic_us();
+        if (exit_requested) 
+        {
+            if (xic) XDestroyIC(xic);
+            if (xim) XCloseIM(xim);
+            XFreeFont(display, font);
+            XCloseDisplay(display);
+            return 0;
+        }
+        /* X input is always served before any output is read. */
+        int input_seen = 0;
+        uint64_t x_ts = trace_begin();
+        while (XPending(display) && !exit_requested) 
+        {
+            XNextEvent(display, &ev);
+            input_seen++;
+            if (ev.type == KeyPress) 
+            {
+                char buf[256];
+                KeySym k = NoSymbol;
+                int len = 0;
+                Status xst = 0;
+                if (xic) {
+                    len = Xutf8LookupString(xic, &ev.xkey, buf, (int)sizeof(buf)-1, &k, &xst);
+                } else {
+                    len = XLookupString(&ev.xkey, buf, sizeof(buf)-1, &k, NULL);
+                }
+                buf[len] = '\0';
+
+                Tab *t = &tabs[active];
+                int ctrl = ev.xkey.state & ControlMask;
+                int shift = ev.xkey.state & ShiftMask;
+
+                if (t->autocomplete_req && !IsModifierKey(k)) autocomplete_cancel(t);
+
+                if (search_mode) {
+                    if (len == 1) {
+                        unsigned char ch = (unsigned char)buf[0];
+                        if (ch == 0x1B) {
+                            search_mode = 0;
+                            search_len = search_cursor = 0;
+                            search_buf[0] = '\0';
+                        } else if (ch == 0x7F || k == XK_BackSpace) {
+                            if (search_cursor > 0) {
+                                memmove(&search_buf[search_cursor-1], &search_buf[search_cursor],
+                                        search_len - search_cursor + 1);
+                                search_cursor--;
+                                search_len--;
+                            }
+                        } else if (ch == '\r' || ch == '\n' || k == XK_Return) {
+                            search_buf[search_len] = '\0';
+                            perform_history_search_and_print(t, search_buf);
+                            search_mode = 0;
+                            search_len = search_cursor = 0;
+                            search_buf[0] = '\0';
+                        } else if (ch >= 32 && ch < 127) {
+                            if (search_len < MAX_LINE_LEN-1) {
+                                memmove(&search_buf[search_cursor+1], &search_buf[search_cursor],
+                                        search_len - search_cursor + 1);
+                                search_buf[search_cursor] = ch;
+                                search_len++;
+                                search_cursor++;
+                            }
+                        }
+                    }
+                    continue;
+                }
+
+                if (ctrl && shift && (k == XK_P || k == XK_p)) 
+                {
+                    hud_visible = !hud_visible;
+                    dashboard_full_redraw = 1;
+                    continue;
+                }
+                if (ctrl && shift && (k == XK_T || k == XK_t)) 
+                {
+                    if (tab_count < MAX_TABS) 
+                    {
+                        init_tab(&tabs[tab_count], basecwd, tab_count+1);
+                        tab_count++;
+                        active = tab_count - 1;
+                    }
+                    continue;
+                }
+                if (ctrl && shift && (k == XK_W || k == XK_w)) 
+                {
+                    if (tab_count > 1) 
+                    {
+                        destroy_tab(&tabs[active]);
+                        for (int i = active; i < tab_count-1; ++i) tabs[i] = tabs[i+1];
+                        tab_count--;
+                        if (active >= tab_count) active = tab_count-1;
+                    } 
+                    else 
+                    {
+                        destroy_tab(&tabs[active]);
+                        tab_count = 0;
+                        XCloseDisplay(display);
+                        exit(0);
+                    }
+                    continue;
+                }
+                if (ctrl && !shift && k == XK_Tab) 
+                {
+                    active = (active + 1) % tab_count;
+                    continue;
+                }
+                if (ctrl && shift && k == XK_Tab) 
+                {
+                    active = (active - 1 + tab_count) % tab_count;
+                    continue;
+                }
+                if (k == XK_Up) 
+                { 
+                    scroll_up(&tabs[active]); 
+                    continue; 
+                }
+                if (k == XK_Down) 
+                { 
+                    scroll_down(&tabs[active]); 
+                    continue; 
+                }
+                if (!search_mode && !ctrl && !shift && k == XK_Tab) {
+                    autocomplete_fill_gui(t, display, win, gc, font);
+                    draw_ui(rend, t, active, tab_count, search_mode, search_buf, search_len, search_cursor);
+                    continue;
+                }
+
+                if (t->fg && len > 0) {
+                    unsigned char ch = (unsigned char)buf[0];
+                    if (!(len == 1 && (ch == 0x03 || ch == 0x1A))) {
+                        if (t->fg->in_fd >= 0) {
+                            ssize_t w = write(t->fg->in_fd, buf, len);
+                            (void)w;
+                        }
+                        continue;
+                    }
+                }
+                if (t->autocomplete_count > 0 && len == 1) 
+                {
+                    unsigned char ch = (unsigned char)buf[0];
+                    int knum = -1;
+                    if (ch >= '1' && ch <= '9') knum = ch - '1';
+                    else if (ch == '0' && t->autocomplete_count >= 10) knum = 9;
+                    if (knum >= 0 && knum < t->autocomplete_count) 
+                    {
+                        autocomplete_record_choice(t, t->autocomplete_matches[knum]);
+                        int matchlen = (int)strlen(t->autocomplete_matches[knum]);
+                        int tail_len = t->current_len - t->autocomplete_pos;
+                        if (t->autocomplete_start + matchlen + tail_len < MAX_LINE_LEN) 
+                        {
+                            memmove(&t->current_line[t->autocomplete_start + matchlen],
+                                    &t->current_line[t->autocomplete_pos], tail_len + 1);
+                            memcpy(&t->current_line[t->autocomplete_start],
+                                   t->autocomplete_matches[knum], matchlen);
+                            t->current_len = t->autocomplete_start + matchlen + tail_len;
+                            t->cursor_pos = t->autocomplete_start + matchlen;
+                        } 
+                        else 
+                        {
+                            t->current_len = t->autocomplete_start + matchlen;
+                            t->cursor_pos = t->current_len;
+                        }
+                        for (int i = 0; i < t->autocomplete_count; i++) 
+                        {
+                            if (t->autocomplete_matches[i]) 
+                            { 
+                                free(t->autocomplete_matches[i]); 
+                                t->autocomplete_matches[i] = NULL; 
+                            }
+                        }
+                        t->autocomplete_count = 0;
+                        scroll_to_cursor(t);
+                        draw_ui(rend, t, active, tab_count, search_mode, search_buf, search_len, search_cursor);
+                        continue;
+                    }
+                    scroll_to_cursor(t);
+                }
+
+                if (len == 1) 
+                {
+                    unsigned char ch = (unsigned char)buf[0];
+                    if (ch == 0x01) 
+                    {
+                        t->cursor_pos = 0;
+                        continue;
+                    } 
+                    else if (ch == 0x05) 
+                    {
+                        t->cursor_pos = t->current_len;
+                        continue;
+                    } 
+                    else if (ch == 0x12) 
+                    {
+                        search_mode = 1;
+                        search_len = search_cursor = 0;
+                        search_buf[0] = '\0';
+                        continue;
+                    } 
+                    else if (ch == 0x03) 
+                    {
+                        if (t->fg) 
+                        {
+                            if (t->fg->pgid > 0) kill(-t->fg->pgid, SIGINT);
+                            push_line(t, "^C");
+                            scroll_to_cursor(t);
+                        } 
+                        else if (t->mw) 
+                        {
+                            stop_multiwatch_tab(t);
+                            push_line(t, "^C - MultiWatch stopped");
+                            scroll_to_cursor(t);
+                        }
+                        continue;
+                    } 
+                    else if (ch == 0x1A) 
+                    {
+                        /* The reaper reports the stop and backgrounds the job. */
+                        if (t->fg && t->fg->pgid > 0) kill(-t->fg->pgid, SIGTSTP);
+                        continue;
+                    }
+                }
+
+                if (k == XK_BackSpace || (len == 1 && buf[0] == 0x7F)) 
+                {
+                    if (t->cursor_pos > 0) 
+                    {
+                        int del_bytes = 1;
+                        int pos = t->cursor_pos - 1;
+                        while (pos > 0 && is_utf8_continuation((unsigned char)t->current_line[pos])) 
+                        {
+                            pos--;
+                            del_bytes++;
+                        }
+                        memmove(&t->current_line[pos],
+                                &t->current_line[t->cursor_pos],
+                                t->current_len - t->cursor_pos + 1);
+                        t->cursor_pos = pos;
+                        t->current_len -= del_bytes;
+                    }
+                    continue;
+                }
+
+                if (k == XK_Return || (len == 1 && (buf[0] == '\r' || buf[0] == '\n'))) 
+                {
+                    if (t->current_len > 0 && t->current_line[t->current_len - 1] == '\\') 
+                    {
+                        if (t->current_len < MAX_LINE_LEN - 1) 
+                        {
+                            t->current_line[t->current_len++] = '\n';
+                            t->current_line[t->current_len] = '\0';
+                            t->cursor_pos = t->current_len;
+                        }
+                        continue;
+                    }
+
+                    t->current_line[t->current_len] = '\0';
+
+                    char display_line[MAX_LINE_LEN];
+                    strncpy(display_line, t->current_line, MAX_LINE_LEN - 1);
+                    display_line[MAX_LINE_LEN - 1] = '\0';
+
+                    push_command_line(t, display_line);
+                    scroll_to_cursor(t);
+
+                    add_history(t->current_line);
+                    run_line_in_tab(t, t->current_line, active + 1);
+
+                    t->current_len = 0;
+                    t->cursor_pos = 0;
+                    t->current_line[0] = '\0';
+                    continue;
+                }
+
+                if (len > 0) {
+                    Tab *t2 = &tabs[active];
+                    int bytes_to_insert = len;
+                    if (t2->current_len + bytes_to_insert < MAX_LINE_LEN - 1) {
+                        memmove(&t2->current_line[t2->cursor_pos + bytes_to_insert],
+                                &t2->current_line[t2->cursor_pos],
+                                t2->current_len - t2->cursor_pos + 1);
+                        memcpy(&t2->current_line[t2->cursor_pos], buf, bytes_to_insert);
+                        t2->cursor_pos += bytes_to_insert;
+                        t2->current_len += bytes_to_insert;
+                        t2->current_line[t2->current_len] = '\0';
+                    }
+                }
+                continue;
+            } else if (ev.type == Expose) {
+                dashboard_full_redraw = 1;
+            } else if (ev.type == ButtonPress) {
+                if (ev.xbutton.button == Button4) {
+                    scroll_up(&tabs[active]);
+                } else if (ev.xbutton.button == Button5) {
+                    scroll_down(&tabs[active]);
+                }
+            }
+        }
+        if (input_seen) trace_end("X events", x_ts, "events", input_seen, NULL, 0);
+
+        /* Sleep until input, output or a child, but no later than the next
+         * due frame when something is waiting to be drawn. */
+        uint64_t now = monotonic_us();
+        uint64_t wait_us = 10000;
+        if (input_seen || XEventsQueued(display, QueuedAlready) > 0) wait_us = 0;
+        else if (dirty) wait_us = now - last_draw_us >= FRAME_US ? 0 : FRAME_US - (now - last_draw_us);
+        if (loop_service(tabs, tab_count, active, &loop, xfd, wait_us, x_input_waiting, display)) dirty = 1;
+        if (tabs[active].mw) dirty = 1;
+        if (hud_sample(tabs, tab_count) && hud_visible) dirty = 1;
+
+        now = monotonic_us();
+        if (now - last_blink_us >= BLINK_US) {
+            cursor_visible = !cursor_visible;
+            last_blink_us = now;
+            dirty = 1;
+        }
+        /* Input is echoed at once; output redraws at most once a frame. */
+        if (input_seen || (dirty && now - last_draw_us >= FRAME_US)) {
+            draw_ui(rend, &tabs[active], active, tab_count,
+                    search_mode, search_buf, search_len, search_cursor);
+            last_draw_us = now;
+            dirty = 0;
+        }
+        uint64_t pass_us = monotonic_us() - pass_start;
+        uint64_t waited = perf_get(&perf.wait_us);
+        perf_set(&perf.loop_us, pass_us > waited ? pass_us - waited : 0);
+    }
+
+    if (xic) XDestroyIC(xic);
+    if (xim) XCloseIM(xim);
+    XFreeFont(display, font);
+    XCloseDisplay(display);
+    return 0;
+}
+#endif
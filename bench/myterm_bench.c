@@ -0,0 +1,315 @@
+/* Microbenchmarks for MyTerm's hot paths. Builds the terminal's own source
+ * without its main() and drives the internals directly, printing one JSON
+ * object per case:
+ *
+ *   {"name":..., "iters":..., "ns_per_op":..., "bytes_per_s":..., "allocs_per_op":...}
+ *
+ * Build:  gcc -std=c11 -O2 bench/myterm_bench.c -o myterm_bench -lX11 -lpthread
+ * Usage:  ./myterm_bench [--files N] [--min-ms N] [case-substring...]
+ */
+#define MYTERM_NO_MAIN
+#include "../MyTerm_X11.c"
+
+#include <ftw.h>
+
+/* Allocation counting: interpose the allocator and forward to glibc. */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+static atomic_ulong bench_allocs;
+
+void *malloc(size_t n)
+{
+    atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t sz)
+{
+    atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+    return __libc_calloc(n, sz);
+}
+
+void *realloc(void *p, size_t n)
+{
+    atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+    return __libc_realloc(p, n);
+}
+
+void free(void *p)
+{
+    __libc_free(p);
+}
+
+typedef struct BenchCase {
+    const char *name;
+    void (*setup)(void);
+    void (*run)(void);
+    void (*teardown)(void);
+    size_t bytes_per_op;
+} BenchCase;
+
+static uint64_t bench_min_us = 300000;
+static int bench_files = 100000;
+static Tab bench_tab;
+
+static void bench_reset_tab(void)
+{
+    destroy_tab(&bench_tab);
+    init_tab(&bench_tab, NULL, 1);
+}
+
+/* append_text: 4 KiB chunks of 64-byte lines, the shape of pipe reads. */
+static char chunk_4k[4096];
+
+static void append_setup(void)
+{
+    for (size_t i = 0; i < sizeof(chunk_4k); ++i)
+        chunk_4k[i] = (i % 64 == 63) ? '\n' : (char)('a' + i % 26);
+    bench_reset_tab();
+}
+
+static void append_run(void)
+{
+    append_text(&bench_tab, chunk_4k, (int)sizeof(chunk_4k));
+}
+
+/* push_line on a full scrollback, so every call pays for eviction. */
+static const char *push_text = "drwxr-xr-x  2 user user 4096 Jan  1 00:00 some-directory-name";
+
+static void push_setup(void)
+{
+    bench_reset_tab();
+    while (bench_tab.lines_count < MAX_LINES) push_line(&bench_tab, push_text);
+}
+
+static void push_run(void)
+{
+    push_line(&bench_tab, push_text);
+}
+
+/* Parsing: a fresh parse every time, and the cached path the engine uses. */
+static const char *parse_text = "cat /var/log/syslog | grep -v debug | sort -k2 > out.txt 2>&1 && echo \"done\" ; ls -l *.c";
+
+static void parse_fresh_run(void)
+{
+    parsed_line_release(parse_shell_line(parse_text));
+}
+
+static void parse_cached_run(void)
+{
+    parsed_line_release(parse_line_cached(parse_text));
+}
+
+/* History search: a full in-memory history and a term with no exact match,
+ * so every entry goes through the substring scan. */
+static void history_setup(void)
+{
+    bench_reset_tab();
+    for (int i = 0; i < HISTORY_MAX; ++i)
+    {
+        char cmd[96];
+        snprintf(cmd, sizeof(cmd), "git commit -m \"change %d\" && make -j%d test-%d", i, i % 16, i % 97);
+        history[i] = strdup(cmd);
+    }
+    history_count = HISTORY_MAX;
+    history_start = 0;
+}
+
+static void history_run(void)
+{
+    perform_history_search_and_print(&bench_tab, "make -j4 tset-50");
+}
+
+static void history_teardown(void)
+{
+    for (int i = 0; i < HISTORY_MAX; ++i)
+    {
+        free(history[i]);
+        history[i] = NULL;
+    }
+    history_count = history_start = 0;
+}
+
+/* Autocomplete of a file argument in a synthetic directory. */
+static char complete_dir[PATH_MAX];
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static void complete_setup(void)
+{
+    snprintf(complete_dir, sizeof(complete_dir), "/tmp/myterm_bench.XXXXXX");
+    if (!mkdtemp(complete_dir))
+    {
+        perror("mkdtemp");
+        exit(1);
+    }
+    for (int i = 0; i < bench_files; ++i)
+    {
+        char path[PATH_MAX + 16];
+        snprintf(path, sizeof(path), "%s/file%06d", complete_dir, i);
+        int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) close(fd);
+    }
+    bench_reset_tab();
+    snprintf(bench_tab.cwd, sizeof(bench_tab.cwd), "%s", complete_dir);
+}
+
+static void complete_drop_cache(void)
+{
+    for (int i = 0; i < DIR_CACHE_SLOTS; ++i)
+    {
+        if (dir_cache[i]) dir_listing_release(dir_cache[i]);
+        dir_cache[i] = NULL;
+    }
+}
+
+/* After the warm-up the listing comes from dir_cache; the cold case drops
+ * it first, so every run rescans the directory (and pays for freeing the
+ * old listing). */
+static void complete_run(void)
+{
+    Tab *t = &bench_tab;
+    snprintf(t->current_line, sizeof(t->current_line), "cat file0421");
+    t->current_len = t->cursor_pos = (int)strlen(t->current_line);
+    autocomplete_fill_gui(t, NULL, 0, NULL, NULL);
+    while (t->autocomplete_req)
+    {
+        if (!autocomplete_poll(t)) sched_yield();
+    }
+    autocomplete_clear(t);
+}
+
+static void complete_cold_run(void)
+{
+    complete_drop_cache();
+    complete_run();
+}
+
+static void complete_teardown(void)
+{
+    complete_drop_cache();
+    nftw(complete_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* multiWatch output handling: 64 KiB chunks of 80-byte lines, printed
+ * plainly and through diff mode against an identical previous run. */
+static char chunk_64k[65536];
+static MWSession bench_ms;
+static MWCommand bench_mc;
+
+static void mw_setup_mode(int diff)
+{
+    for (size_t i = 0; i < sizeof(chunk_64k); ++i)
+        chunk_64k[i] = (i % 80 == 79) ? '\n' : (char)('0' + i % 10);
+    bench_reset_tab();
+    memset(&bench_ms, 0, sizeof(bench_ms));
+    memset(&bench_mc, 0, sizeof(bench_mc));
+    bench_ms.cmds = &bench_mc;
+    bench_ms.n = 1;
+    bench_ms.diff = diff;
+    bench_mc.session = &bench_ms;
+    bench_mc.cmd = "bench";
+    bench_mc.partial = malloc(MAX_LINE_LEN);
+    if (diff)
+    {
+        mw_emit(&bench_tab, &bench_mc, chunk_64k, sizeof(chunk_64k));
+        bench_mc.prev_hash = bench_mc.cur_hash;
+        bench_mc.prev_n = bench_mc.cur_n;
+        bench_mc.prev_cap = bench_mc.cur_cap;
+        bench_mc.cur_hash = NULL;
+        bench_mc.cur_n = bench_mc.cur_cap = 0;
+    }
+}
+
+static void mw_plain_setup(void) { mw_setup_mode(0); }
+static void mw_diff_setup(void) { mw_setup_mode(1); }
+
+static void mw_run(void)
+{
+    bench_mc.cur_n = 0;
+    bench_mc.partial_len = 0;
+    mw_emit(&bench_tab, &bench_mc, chunk_64k, sizeof(chunk_64k));
+}
+
+static void mw_teardown(void)
+{
+    free(bench_mc.partial);
+    free(bench_mc.prev_hash);
+    free(bench_mc.cur_hash);
+}
+
+static const BenchCase cases[] = {
+    { "append_text_4k", append_setup, append_run, NULL, sizeof(chunk_4k) },
+    { "push_line_evict", push_setup, push_run, NULL, 0 },
+    { "parse_fresh", NULL, parse_fresh_run, NULL, 0 },
+    { "parse_cached", NULL, parse_cached_run, NULL, 0 },
+    { "history_search", history_setup, history_run, history_teardown, 0 },
+    { "autocomplete_dir", complete_setup, complete_run, complete_teardown, 0 },
+    { "autocomplete_dir_cold", complete_setup, complete_cold_run, complete_teardown, 0 },
+    { "multiwatch_chunk", mw_plain_setup, mw_run, mw_teardown, sizeof(chunk_64k) },
+    { "multiwatch_diff_chunk", mw_diff_setup, mw_run, mw_teardown, sizeof(chunk_64k) },
+};
+
+static int case_selected(const char *name, char **filters, int nfilters)
+{
+    if (nfilters == 0) return 1;
+    for (int i = 0; i < nfilters; ++i)
+        if (strstr(name, filters[i])) return 1;
+    return 0;
+}
+
+/* Runs batches of doubling size until one takes at least bench_min_us,
+ * after one untimed warm-up call. */
+static void run_case(const BenchCase *c)
+{
+    if (c->setup) c->setup();
+    c->run();
+    uint64_t iters = 1, elapsed = 0;
+    unsigned long allocs = 0;
+    for (;;)
+    {
+        unsigned long a0 = atomic_load(&bench_allocs);
+        uint64_t t0 = monotonic_us();
+        for (uint64_t i = 0; i < iters; ++i) c->run();
+        elapsed = monotonic_us() - t0;
+        allocs = atomic_load(&bench_allocs) - a0;
+        if (elapsed >= bench_min_us || iters >= (1ULL << 32)) break;
+        iters *= 2;
+    }
+    if (c->teardown) c->teardown();
+
+    double ns = elapsed * 1000.0 / iters;
+    double bps = (c->bytes_per_op && elapsed) ? c->bytes_per_op * (double)iters * 1e6 / elapsed : 0.0;
+    printf("{\"name\":\"%s\",\"iters\":%llu,\"ns_per_op\":%.1f,\"bytes_per_s\":%.0f,\"allocs_per_op\":%.3f}\n",
+           c->name, (unsigned long long)iters, ns, bps, (double)allocs / iters);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    char **filters = calloc(argc, sizeof(char *));
+    int nfilters = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--files") == 0 && i + 1 < argc) bench_files = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) bench_min_us = (uint64_t)atoi(argv[++i]) * 1000;
+        else filters[nfilters++] = argv[i];
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (FONT_HEIGHT <= 0) FONT_HEIGHT = font_ascent + font_descent;
+    init_tab(&bench_tab, NULL, 1);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+        if (case_selected(cases[i].name, filters, nfilters)) run_case(&cases[i]);
+
+    destroy_tab(&bench_tab);
+    free(filters);
+    return 0;
+}
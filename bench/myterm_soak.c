@@ -0,0 +1,296 @@
+/* Soak test: opens N tabs, each running a synthetic producer at a fixed byte
+ * rate and line length, plus one tab running M multiWatch commands, and
+ * drives them through the same event loop, scheduler and draw path as the
+ * GUI, rendering into the null (or offscreen) backend. A helper thread
+ * plays the keyboard. Once a second it prints a JSON sample of ingest,
+ * frames, RSS and open fds, and a summary with frame time and keypress
+ * latency percentiles at the end.
+ *
+ * Build:  gcc -std=c11 -O2 bench/myterm_soak.c -o myterm_soak -lX11 -lpthread
+ * Usage:  ./myterm_soak [--tabs N] [--rate BYTES_PER_S] [--line-len N] [--watch M]
+ *                       [--watch-bytes N] [--duration SEC] [--key-ms N]
+ *                       [--io-threads N] [--offscreen]
+ */
+#define MYTERM_NO_MAIN
+#include "../MyTerm_X11.c"
+
+/* Child side: writes len-byte lines at rate bytes/s (0 = as fast as the
+ * pipe takes them), stopping after total bytes if total is nonzero. */
+static int produce(long rate, int len, long total)
+{
+    if (len < 2) len = 2;
+    char *line = malloc(len);
+    if (!line) return 1;
+    for (int i = 0; i < len - 1; ++i) line[i] = (char)('a' + i % 26);
+    line[len - 1] = '\n';
+    uint64_t start = monotonic_us();
+    long sent = 0;
+    for (;;)
+    {
+        if (total && sent >= total) break;
+        if (rate > 0)
+        {
+            long due = (long)((monotonic_us() - start) * (double)rate / 1e6);
+            if (sent >= due)
+            {
+                usleep(2000);
+                continue;
+            }
+        }
+        if (write(1, line, len) != len) break;
+        sent += len;
+    }
+    free(line);
+    return 0;
+}
+
+/* The pretend keyboard: at each tick it marks a key as pending, unless the
+ * last one has not been handled yet, and wakes the loop through key_fd. */
+static int key_fd = -1;
+static int key_interval_ms = 50;
+static atomic_ullong key_pending_since;
+static atomic_int soak_stop;
+
+static void *key_thread(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&soak_stop))
+    {
+        usleep((useconds_t)key_interval_ms * 1000);
+        unsigned long long none = 0;
+        if (!atomic_compare_exchange_strong(&key_pending_since, &none, (unsigned long long)monotonic_us()))
+            continue;
+        uint64_t one = 1;
+        ssize_t n = write(key_fd, &one, sizeof(one));
+        (void)n;
+    }
+    return NULL;
+}
+
+static int key_waiting(void *arg)
+{
+    (void)arg;
+    return atomic_load(&key_pending_since) != 0;
+}
+
+static long rss_kb(void)
+{
+    long size = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return -1;
+    if (fscanf(f, "%ld %ld", &size, &resident) != 2) resident = -1;
+    fclose(f);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int open_fds(void)
+{
+    DIR *d = opendir("/proc/self/fd");
+    if (!d) return -1;
+    int n = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL)
+        if (de->d_name[0] != '.') n++;
+    closedir(d);
+    return n - 1;
+}
+
+static Tab soak_tabs[MAX_TABS];
+
+int main(int argc, char *argv[])
+{
+    int ntabs = 4, line_len = 80, nwatch = 4, duration_s = 30, io_threads = 0, offscreen = 0;
+    long rate = 1000000, watch_bytes = 16384;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--produce") == 0 && i + 3 < argc)
+            return produce(atol(argv[i + 1]), atoi(argv[i + 2]), atol(argv[i + 3]));
+        else if (strcmp(argv[i], "--tabs") == 0 && i + 1 < argc) ntabs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atol(argv[++i]);
+        else if (strcmp(argv[i], "--line-len") == 0 && i + 1 < argc) line_len = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) nwatch = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--watch-bytes") == 0 && i + 1 < argc) watch_bytes = atol(argv[++i]);
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) duration_s = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--key-ms") == 0 && i + 1 < argc) key_interval_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) io_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--offscreen") == 0) offscreen = 1;
+        else
+        {
+            fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[i]);
+            return 2;
+        }
+    }
+    if (ntabs < 0) ntabs = 0;
+    if (ntabs > MAX_TABS - 1) ntabs = MAX_TABS - 1;
+    if (key_interval_ms < 1) key_interval_ms = 1;
+
+    char self[PATH_MAX];
+    ssize_t sl = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (sl <= 0)
+    {
+        perror("readlink /proc/self/exe");
+        return 1;
+    }
+    self[sl] = '\0';
+
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t chld_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, NULL);
+    int sigchld_fd = signalfd(-1, &chld_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    key_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    io_start(io_threads);
+    if (FONT_HEIGHT <= 0) FONT_HEIGHT = font_ascent + font_descent;
+
+    long rss_start = rss_kb();
+    int fds_start = open_fds();
+
+    int tab_count = ntabs + (nwatch > 0);
+    for (int i = 0; i < ntabs; ++i)
+    {
+        char cmd[PATH_MAX + 64];
+        init_tab(&soak_tabs[i], NULL, i + 1);
+        snprintf(cmd, sizeof(cmd), "%s --produce %ld %d 0", self, rate, line_len);
+        run_line_in_tab(&soak_tabs[i], cmd, i + 1);
+    }
+    if (nwatch > 0)
+    {
+        Tab *wt = &soak_tabs[ntabs];
+        size_t cap = (size_t)nwatch * (PATH_MAX + 64) + 64;
+        char *cmd = malloc(cap);
+        if (!cmd) return 1;
+        int off = snprintf(cmd, cap, "multiWatch -n 1 [");
+        for (int m = 0; m < nwatch && off < (int)cap; ++m)
+            off += snprintf(cmd + off, cap - off, "%s\"%s --produce 0 %d %ld\"", m ? "," : "", self, line_len, watch_bytes);
+        if (off < (int)cap) snprintf(cmd + off, cap - off, "]");
+        init_tab(wt, NULL, tab_count);
+        run_line_in_tab(wt, cmd, tab_count);
+        free(cmd);
+    }
+    if (tab_count == 0)
+    {
+        init_tab(&soak_tabs[0], NULL, 1);
+        tab_count = 1;
+    }
+
+    Renderer null_rend;
+    OffscreenRenderer off;
+    Renderer *rend = offscreen ? offscreen_renderer_init(&off, WIDTH, HEIGHT) : null_renderer_init(&null_rend);
+    if (!rend) rend = null_renderer_init(&null_rend);
+
+    pthread_t kth;
+    int have_keys = pthread_create(&kth, NULL, key_thread, NULL) == 0;
+
+    static LatencyHist frame_hist, key_hist, sample_frames;
+    LoopState loop = { sigchld_fd, 0, 0 };
+    int active = 0, dirty = 1;
+    unsigned long frames = 0, keys = 0;
+    long rss_max = rss_start;
+    int fds_max = fds_start;
+    uint64_t start = monotonic_us(), end = start + (uint64_t)duration_s * 1000000;
+    uint64_t last_draw_us = 0, next_sample = start + 1000000;
+    uint64_t sample_bytes = 0, sample_lines = 0;
+    unsigned long sample_frame_count = 0;
+
+    for (;;)
+    {
+        uint64_t now = monotonic_us();
+        if (now >= end) break;
+        uint64_t wait_us = 10000;
+        if (dirty) wait_us = now - last_draw_us >= FRAME_US ? 0 : FRAME_US - (now - last_draw_us);
+        if (loop_service(soak_tabs, tab_count, active, &loop, key_fd, wait_us, key_waiting, NULL)) dirty = 1;
+
+        /* A key is echoed at once, as the GUI does; its latency runs from
+         * the moment it was "pressed" to the end of the redraw. */
+        unsigned long long pressed = atomic_load(&key_pending_since);
+        int input_seen = 0;
+        if (pressed)
+        {
+            uint64_t cnt;
+            ssize_t n = read(key_fd, &cnt, sizeof(cnt));
+            (void)n;
+            Tab *t = &soak_tabs[active];
+            if (t->current_len >= 60) t->current_len = t->cursor_pos = 0;
+            t->current_line[t->current_len++] = 'x';
+            t->current_line[t->current_len] = '\0';
+            t->cursor_pos = t->current_len;
+            input_seen = 1;
+        }
+
+        now = monotonic_us();
+        if (input_seen || (dirty && now - last_draw_us >= FRAME_US))
+        {
+            draw_ui(rend, &soak_tabs[active], active, tab_count, 0, "", 0, 0);
+            uint64_t drawn = monotonic_us();
+            hist_record(&frame_hist, drawn - now);
+            hist_record(&sample_frames, drawn - now);
+            frames++;
+            sample_frame_count++;
+            last_draw_us = drawn;
+            dirty = 0;
+            if (input_seen)
+            {
+                hist_record(&key_hist, drawn - pressed);
+                keys++;
+                atomic_store(&key_pending_since, 0);
+            }
+        }
+
+        if (now >= next_sample)
+        {
+            uint64_t bytes = 0, lines = 0;
+            for (int i = 0; i < tab_count; ++i)
+            {
+                bytes += soak_tabs[i].bytes_in;
+                lines += soak_tabs[i].lines_in;
+            }
+            long rss = rss_kb();
+            int fds = open_fds();
+            if (rss > rss_max) rss_max = rss;
+            if (fds > fds_max) fds_max = fds;
+            printf("{\"t_s\":%.1f,\"ingest_bytes_per_s\":%llu,\"lines_per_s\":%llu,\"frames\":%lu,"
+                   "\"frame_p99_us\":%llu,\"rss_kb\":%ld,\"fds\":%d}\n",
+                   (now - start) / 1e6, (unsigned long long)(bytes - sample_bytes),
+                   (unsigned long long)(lines - sample_lines), sample_frame_count,
+                   (unsigned long long)hist_percentile(&sample_frames, 99), rss, fds);
+            fflush(stdout);
+            sample_bytes = bytes;
+            sample_lines = lines;
+            sample_frame_count = 0;
+            memset(&sample_frames, 0, sizeof(sample_frames));
+            next_sample += 1000000;
+        }
+    }
+
+    atomic_store(&soak_stop, 1);
+    if (have_keys) pthread_join(kth, NULL);
+    uint64_t elapsed = monotonic_us() - start;
+    uint64_t bytes = 0, lines = 0;
+    for (int i = 0; i < tab_count; ++i)
+    {
+        bytes += soak_tabs[i].bytes_in;
+        lines += soak_tabs[i].lines_in;
+    }
+    long rss_end = rss_kb();
+    int fds_end = open_fds();
+    if (rss_end > rss_max) rss_max = rss_end;
+    if (fds_end > fds_max) fds_max = fds_end;
+    printf("{\"summary\":true,\"tabs\":%d,\"watch\":%d,\"rate\":%ld,\"line_len\":%d,\"duration_s\":%.1f,"
+           "\"ingest_bytes_per_s\":%.0f,\"lines_per_s\":%.0f,\"frames\":%lu,"
+           "\"frame_p50_us\":%llu,\"frame_p99_us\":%llu,\"frame_max_us\":%llu,"
+           "\"keys\":%lu,\"key_p50_us\":%llu,\"key_p99_us\":%llu,\"key_max_us\":%llu,"
+           "\"rss_start_kb\":%ld,\"rss_end_kb\":%ld,\"rss_max_kb\":%ld,"
+           "\"fds_start\":%d,\"fds_end\":%d,\"fds_max\":%d}\n",
+           ntabs, nwatch, rate, line_len, elapsed / 1e6,
+           bytes * 1e6 / elapsed, lines * 1e6 / elapsed, frames,
+           (unsigned long long)hist_percentile(&frame_hist, 50), (unsigned long long)hist_percentile(&frame_hist, 99),
+           (unsigned long long)frame_hist.max,
+           keys, (unsigned long long)hist_percentile(&key_hist, 50), (unsigned long long)hist_percentile(&key_hist, 99),
+           (unsigned long long)key_hist.max,
+           rss_start, rss_end, rss_max, fds_start, fds_end, fds_max);
+
+    for (int i = 0; i < tab_count; ++i) destroy_tab(&soak_tabs[i]);
+    if (offscreen && rend == &off.base) free(off.pixels);
+    return 0;
+}